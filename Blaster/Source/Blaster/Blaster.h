@@ -3,7 +3,11 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
 
 #define ECC_SkeletalMesh ECollisionChannel::ECC_GameTraceChannel1
 #define ECC_Blood ECollisionChannel::ECC_GameTraceChannel2 // need to set the player mesh to block this for blood particles to show
-#define ECC_PlayerHitBox ECollisionChannel::ECC_GameTraceChannel3
\ No newline at end of file
+#define ECC_PlayerHitBox ECollisionChannel::ECC_GameTraceChannel3
+
+// server-side rewind: "stat BlasterSSR" in game, -trace=cpu,stats for Unreal Insights
+DECLARE_STATS_GROUP(TEXT("BlasterSSR"), STATGROUP_BlasterSSR, STATCAT_Advanced);
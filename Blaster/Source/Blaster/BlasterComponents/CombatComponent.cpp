@@ -65,6 +65,8 @@ void UCombatComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActo
 		SetHUDCrosshairs(DeltaTime);
 		InterpFOV(DeltaTime);
 	}
+
+	FlushFireEvents();
 }
 
 void UCombatComponent::FireButtonPressed(bool bPressed)
@@ -108,9 +110,7 @@ void UCombatComponent::FireProjectileWeapon()
 {
 	if (EquippedWeapon && Character)
 	{
-		HitTarget = EquippedWeapon->bUseScatter ? EquippedWeapon->TraceEndWithScatter(HitTarget) : HitTarget;
-		if(!Character->HasAuthority()) LocalFire(HitTarget);
-		ServerFire(HitTarget, EquippedWeapon->FireDelay);
+		SendFireEvent(FFireEvent{ HitTarget, EquippedWeapon->NextShotSequence() });
 	}
 	
 }
@@ -119,9 +119,7 @@ void UCombatComponent::FireHitScanWeapon()
 {
 	if (EquippedWeapon && Character)
 	{
-		HitTarget = EquippedWeapon->bUseScatter ? EquippedWeapon->TraceEndWithScatter(HitTarget) : HitTarget;
-		if (!Character->HasAuthority()) LocalFire(HitTarget);
-		ServerFire(HitTarget, EquippedWeapon->FireDelay);
+		SendFireEvent(FFireEvent{ HitTarget, EquippedWeapon->NextShotSequence() });
 	}
 }
 
@@ -132,10 +130,7 @@ void UCombatComponent::FireShotgun()
 		AShotgun* Shotgun = Cast<AShotgun>(EquippedWeapon);
 		if (Shotgun)
 		{
-			TArray<FVector_NetQuantize> HitTargets;
-			Shotgun->ShotgunTraceEndWithScatter(HitTarget, HitTargets);
-			if (!Character->HasAuthority()) LocalShotgunFire(HitTargets);
-			ServerShotgunFire(HitTargets, EquippedWeapon->FireDelay);
+			SendFireEvent(FFireEvent{ HitTarget, Shotgun->NextShotSequence() });
 		}
 	}
 }
@@ -165,66 +160,127 @@ void UCombatComponent::FireTimerFinished()
 	}
 }
 
-void UCombatComponent::ServerFire_Implementation(const FVector_NetQuantize& TraceHitTarget, const float FireDelay)
+void UCombatComponent::SendFireEvent(const FFireEvent& FireEvent)
 {
-	MultiCastFire(TraceHitTarget);
+	if (Character == nullptr || EquippedWeapon == nullptr) return;
+	if (Character->HasAuthority())
+	{
+		AcceptFireEvent(EquippedWeapon, FireEvent);
+	}
+	else
+	{
+		PlayFireEvent(FireEvent);
+		AddFireEvent(ServerFireBatch, ServerFireSendsLeft, FireEvent);
+	}
 }
 
-bool UCombatComponent::ServerFire_Validate(const FVector_NetQuantize& TraceHitTarget, const float FireDelay)
+void UCombatComponent::AcceptFireEvent(AWeapon* Weapon, const FFireEvent& FireEvent)
 {
-	if (EquippedWeapon)
+	// shots fired before a swap, and shots repeated by an earlier batch
+	if (Weapon == nullptr || Weapon != EquippedWeapon || !Weapon->AcceptShotSequence(FireEvent.ShotSequence)) return;
+
+	PlayFireEvent(FireEvent);
+	AddFireEvent(MulticastFireBatch, MulticastFireSendsLeft, FireEvent);
+}
+
+void UCombatComponent::PlayFireEvent(const FFireEvent& FireEvent)
+{
+	if (EquippedWeapon == nullptr) return;
+	if (EquippedWeapon->FireType == EFireType::EFT_Shotgun)
+	{
+		LocalShotgunFire(FireEvent.HitTarget, FireEvent.ShotSequence);
+	}
+	else
 	{
-		bool bNearlyEqual = FMath::IsNearlyEqual(EquippedWeapon->FireDelay, FireDelay, 0.001f);
-		return bNearlyEqual;
+		LocalFire(FireEvent.HitTarget, FireEvent.ShotSequence);
 	}
-	return true;
 }
 
-void UCombatComponent::MultiCastFire_Implementation(const FVector_NetQuantize& TraceHitTarget)
+void UCombatComponent::AddFireEvent(FFireEventBatch& Batch, int32& SendsLeft, const FFireEvent& FireEvent)
 {
-	if (Character && Character->IsLocallyControlled() && !Character->HasAuthority()) return;
-	LocalFire(TraceHitTarget);
+	if (Batch.Weapon != EquippedWeapon)
+	{
+		Batch.Weapon = EquippedWeapon;
+		Batch.Events.Reset();
+	}
+	if (Batch.Events.Num() == MaxFireEventsPerBatch)
+	{
+		Batch.Events.RemoveAt(0, 1, EAllowShrinking::No);
+	}
+	Batch.Events.Add(FireEvent);
+	SendsLeft = FireEventRedundancy + 1;
 }
 
-void UCombatComponent::ServerShotgunFire_Implementation(const TArray<FVector_NetQuantize>& TraceHitTargets, const float FireDelay)
+void UCombatComponent::FlushFireEvents()
 {
-	MulticastShotgunFire(TraceHitTargets);
+	if (ServerFireSendsLeft > 0)
+	{
+		ServerFireEvents(ServerFireBatch, ServerFireBatch.Weapon ? ServerFireBatch.Weapon->FireDelay : 0.f);
+		if (--ServerFireSendsLeft == 0)
+		{
+			ServerFireBatch.Events.Reset();
+		}
+	}
+	if (MulticastFireSendsLeft > 0)
+	{
+		MulticastFireEvents(MulticastFireBatch);
+		if (--MulticastFireSendsLeft == 0)
+		{
+			MulticastFireBatch.Events.Reset();
+		}
+	}
 }
 
-bool UCombatComponent::ServerShotgunFire_Validate(const TArray<FVector_NetQuantize>& TraceHitTargets, const float FireDelay)
+void UCombatComponent::ServerFireEvents_Implementation(const FFireEventBatch& Batch, const float FireDelay)
 {
-	if (EquippedWeapon)
+	// batches still in flight across a swap are for a weapon that's no longer equipped, drop them without kicking the client
+	if (Batch.Weapon == nullptr || Batch.Weapon != EquippedWeapon) return;
+	if (!FMath::IsNearlyEqual(Batch.Weapon->FireDelay, FireDelay, 0.001f)) return;
+
+	for (const FFireEvent& FireEvent : Batch.Events)
 	{
-		bool bNearlyEqual = FMath::IsNearlyEqual(EquippedWeapon->FireDelay, FireDelay, 0.001f);
-		return bNearlyEqual;
+		AcceptFireEvent(Batch.Weapon, FireEvent);
 	}
-	return true;
 }
 
-void UCombatComponent::MulticastShotgunFire_Implementation(const TArray<FVector_NetQuantize>& TraceHitTargets)
+bool UCombatComponent::ServerFireEvents_Validate(const FFireEventBatch& Batch, const float FireDelay)
 {
-	if (Character && Character->IsLocallyControlled() && !Character->HasAuthority()) return;
-	LocalShotgunFire(TraceHitTargets);
+	return Batch.Events.Num() <= MaxFireEventsPerBatch;
+}
+
+void UCombatComponent::MulticastFireEvents_Implementation(const FFireEventBatch& Batch)
+{
+	// the server played these when it accepted them, the owning client when it fired them
+	if (Character == nullptr || Character->HasAuthority() || Character->IsLocallyControlled()) return;
+	if (Batch.Weapon == nullptr || Batch.Weapon != EquippedWeapon) return;
+
+	for (const FFireEvent& FireEvent : Batch.Events)
+	{
+		if (EquippedWeapon->AcceptShotSequence(FireEvent.ShotSequence))
+		{
+			PlayFireEvent(FireEvent);
+		}
+	}
 }
 
-void UCombatComponent::LocalFire(const FVector_NetQuantize& TraceHitTarget)
+void UCombatComponent::LocalFire(const FVector_NetQuantize& TraceHitTarget, uint16 ShotSequence)
 {
 	if (EquippedWeapon == nullptr) return;
 	if (Character && CombatState == ECombatState::ECS_Unoccupied)
 	{
 		Character->PlayFireMontage(bAiming);
-		EquippedWeapon->Fire(TraceHitTarget);
+		EquippedWeapon->Fire(TraceHitTarget, ShotSequence);
 	}
 }
 
-void UCombatComponent::LocalShotgunFire(const TArray<FVector_NetQuantize>& TraceHitTargets)
+void UCombatComponent::LocalShotgunFire(const FVector_NetQuantize& TraceHitTarget, uint16 ShotSequence)
 {
 	AShotgun* Shotgun = Cast<AShotgun>(EquippedWeapon);
 	if (Shotgun == nullptr || Character == nullptr) return;
 	if (CombatState == ECombatState::ECS_Unoccupied)
 	{
 		Character->PlayFireMontage(bAiming);
-		Shotgun->FireShotgun(TraceHitTargets);
+		Shotgun->FireShotgun(TraceHitTarget, ShotSequence);
 	}
 }
 
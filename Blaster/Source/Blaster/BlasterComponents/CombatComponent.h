@@ -8,6 +8,34 @@
 #include "Blaster/BlasterTypes/CombatState.h"
 #include "CombatComponent.generated.h"
 
+// One shot of the equipped weapon, see UCombatComponent::ServerFireEvents
+USTRUCT()
+struct FFireEvent
+{
+	GENERATED_BODY()
+
+	// unscattered target, scatter is drawn from ShotSequence wherever the shot is played
+	UPROPERTY()
+	FVector_NetQuantize HitTarget;
+
+	UPROPERTY()
+	uint16 ShotSequence = 0;
+};
+
+// The newest shots of one weapon. Sent unreliably, and repeated for a few ticks after the last new shot
+// so a lost packet rarely loses a shot; receivers drop shots they have already played by their sequence number.
+USTRUCT()
+struct FFireEventBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class AWeapon* Weapon = nullptr;
+
+	UPROPERTY()
+	TArray<FFireEvent> Events;
+};
+
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class BLASTER_API UCombatComponent : public UActorComponent
 {
@@ -53,20 +81,30 @@ protected:
 	void FireHitScanWeapon();
 	void FireShotgun();
 
-	void LocalFire(const FVector_NetQuantize& TraceHitTarget);
-	void LocalShotgunFire(const TArray<FVector_NetQuantize>& TraceHitTargets);
+	void LocalFire(const FVector_NetQuantize& TraceHitTarget, uint16 ShotSequence);
+	void LocalShotgunFire(const FVector_NetQuantize& TraceHitTarget, uint16 ShotSequence);
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerFire(const FVector_NetQuantize& TraceHitTarget, const float FireDelay);
+	/**
+	* Fire events
+	* Shots are batched per tick: the owning client sends its batch to the server, which plays the shots it accepts
+	* and multicasts them to the simulated proxies the character is relevant to. See AWeapon::TraceEndWithScatter
+	*/
 
-	UFUNCTION(NetMulticast, Reliable)
-	void MultiCastFire(const FVector_NetQuantize& TraceHitTarget);
+	// Plays a shot locally if needed and queues it for the server, or on the server accepts it straight away
+	void SendFireEvent(const FFireEvent& FireEvent);
 
-	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerShotgunFire(const TArray<FVector_NetQuantize>& TraceHitTargets, const float FireDelay);
+	// Server. Plays the shot and queues it for the simulated proxies, unless it was already played or is stale
+	void AcceptFireEvent(AWeapon* Weapon, const FFireEvent& FireEvent);
 
-	UFUNCTION(NetMulticast, Reliable)
-	void MulticastShotgunFire(const TArray<FVector_NetQuantize>& TraceHitTargets);
+	void PlayFireEvent(const FFireEvent& FireEvent);
+	void AddFireEvent(FFireEventBatch& Batch, int32& SendsLeft, const FFireEvent& FireEvent);
+	void FlushFireEvents();
+
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void ServerFireEvents(const FFireEventBatch& Batch, const float FireDelay);
+
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireEvents(const FFireEventBatch& Batch);
 
 	void TraceUnderCrosshairs(FHitResult& TraceHitResult);
 
@@ -157,6 +195,22 @@ private:
 
 	bool CanFire();
 
+	// shots waiting to go to the server, and to the simulated proxies
+	UPROPERTY()
+	FFireEventBatch ServerFireBatch;
+	UPROPERTY()
+	FFireEventBatch MulticastFireBatch;
+
+	// ticks each batch is still sent for
+	int32 ServerFireSendsLeft = 0;
+	int32 MulticastFireSendsLeft = 0;
+
+	static constexpr int32 MaxFireEventsPerBatch = 8;
+
+	// times a batch is sent again after its newest shot
+	UPROPERTY(EditAnywhere, Category = Combat)
+	int32 FireEventRedundancy = 2;
+
 	/*
 	* Instead of putting this code in the weapon class, it can be put here if we wanted the player to be able to hold different ammo types like in a survival game.
 	* 
@@ -3,45 +3,151 @@
 
 #include "LagCompensationComponent.h"
 #include "Blaster/Character/BlasterCharacter.h"
-#include "Components/BoxComponent.h"
 #include "DrawDebugHelpers.h"
 #include "Blaster/Weapon/Weapon.h"
+#include "Blaster/Weapon/Shotgun.h"
+#include "Blaster/Weapon/ProjectileWeapon.h"
+#include "Blaster/BlasterComponents/CombatComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "PhysicsEngine\PhysicsAsset.h"
 #include "Math/Vector.h"
 #include "Blaster/Blaster.h"
+#include "Engine/NetDriver.h"
+#include "Async/ParallelFor.h"
+#include "Blaster/BlasterSubsystems/LagCompensationSubsystem.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_CYCLE_STAT(TEXT("Confirm Hits"), STAT_SSRConfirmHits, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Score Requests"), STAT_SSRScoreRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Batches"), STAT_SSRRewindBatches, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hit Requests"), STAT_SSRHitRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Missed Requests"), STAT_SSRMissedRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occluded Requests"), STAT_SSROccludedRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("No History Requests"), STAT_SSRNoHistoryRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Too Old Requests"), STAT_SSRTooOldRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth < 50 ms"), STAT_SSRRewindDepth50, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth < 100 ms"), STAT_SSRRewindDepth100, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth < 150 ms"), STAT_SSRRewindDepth150, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth < 250 ms"), STAT_SSRRewindDepth250, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth < 500 ms"), STAT_SSRRewindDepth500, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rewind Depth >= 500 ms"), STAT_SSRRewindDepthMore, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency < 10 us"), STAT_SSRRequestLatency10, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency < 25 us"), STAT_SSRRequestLatency25, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency < 50 us"), STAT_SSRRequestLatency50, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency < 100 us"), STAT_SSRRequestLatency100, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency < 250 us"), STAT_SSRRequestLatency250, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Request Latency >= 250 us"), STAT_SSRRequestLatencyMore, STATGROUP_BlasterSSR);
+
+// What became of a score request once the server rewound it
+enum class EScoreRequestOutcome : uint8
+{
+	Hit,
+	Miss,
+	// static geometry between the shooter and the claimed hit
+	Occluded,
+	// the trace reached characters with no saved frames at HitTime, e.g. just spawned
+	NoHistory,
+	// HitTime is further back than MaxRecordTime
+	TooOld
+};
+
+// Tallies a request under stat BlasterSSR, with how far back it asked the server to rewind and what it cost.
+// The depth histogram is what MaxRecordTime and the server tick rate are tuned against,
+// the latency one is the cycles spent on the request, whichever thread did the work.
+static void CountScoreRequest(EScoreRequestOutcome Outcome, float RewindDepth, uint64 Cycles)
+{
+#if STATS
+	switch (Outcome)
+	{
+	case EScoreRequestOutcome::Hit: INC_DWORD_STAT(STAT_SSRHitRequests); break;
+	case EScoreRequestOutcome::Miss: INC_DWORD_STAT(STAT_SSRMissedRequests); break;
+	case EScoreRequestOutcome::Occluded: INC_DWORD_STAT(STAT_SSROccludedRequests); break;
+	case EScoreRequestOutcome::NoHistory: INC_DWORD_STAT(STAT_SSRNoHistoryRequests); break;
+	case EScoreRequestOutcome::TooOld: INC_DWORD_STAT(STAT_SSRTooOldRequests); break;
+	}
+
+	const float DepthMs = RewindDepth * 1000.f;
+	if (DepthMs < 50.f) { INC_DWORD_STAT(STAT_SSRRewindDepth50); }
+	else if (DepthMs < 100.f) { INC_DWORD_STAT(STAT_SSRRewindDepth100); }
+	else if (DepthMs < 150.f) { INC_DWORD_STAT(STAT_SSRRewindDepth150); }
+	else if (DepthMs < 250.f) { INC_DWORD_STAT(STAT_SSRRewindDepth250); }
+	else if (DepthMs < 500.f) { INC_DWORD_STAT(STAT_SSRRewindDepth500); }
+	else { INC_DWORD_STAT(STAT_SSRRewindDepthMore); }
+
+	const double LatencyUs = FPlatformTime::ToSeconds64(Cycles) * 1000000.0;
+	if (LatencyUs < 10.0) { INC_DWORD_STAT(STAT_SSRRequestLatency10); }
+	else if (LatencyUs < 25.0) { INC_DWORD_STAT(STAT_SSRRequestLatency25); }
+	else if (LatencyUs < 50.0) { INC_DWORD_STAT(STAT_SSRRequestLatency50); }
+	else if (LatencyUs < 100.0) { INC_DWORD_STAT(STAT_SSRRequestLatency100); }
+	else if (LatencyUs < 250.0) { INC_DWORD_STAT(STAT_SSRRequestLatency250); }
+	else { INC_DWORD_STAT(STAT_SSRRequestLatencyMore); }
+#endif
+}
+
+FCapsuleInformation FFramePackageCapsule::GetCapsule(int32 Index) const
+{
+	FCapsuleInformation CapsuleInfo;
+	CapsuleInfo.A = GetA(Index);
+	CapsuleInfo.B = GetB(Index);
+	CapsuleInfo.Radius = Layout->Radii[Index];
+	CapsuleInfo.Length = Layout->Lengths[Index];
+	CapsuleInfo.HitboxType = Layout->HitboxTypes[Index];
+	return CapsuleInfo;
+}
 
 ULagCompensationComponent::ULagCompensationComponent()
 {
-	PrimaryComponentTick.bCanEverTick = true;
-
+	// recording and score requests are driven by ULagCompensationSubsystem
+	PrimaryComponentTick.bCanEverTick = false;
 }
 
 void ULagCompensationComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
+	if (GetOwner() && GetOwner()->HasAuthority())
+	{
+		LagCompensationSubsystem = GetWorld()->GetSubsystem<ULagCompensationSubsystem>();
+		if (LagCompensationSubsystem)
+		{
+			LagCompensationSubsystem->Register(this);
+		}
+	}
 }
 
-void ULagCompensationComponent::ShowFramePackage(const FFramePackage& Package, const FColor& Color)
+void ULagCompensationComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	for (auto& BoxInfo : Package.HitBoxInfo)
+	if (LagCompensationSubsystem)
 	{
-		DrawDebugBox(
-			GetWorld(),
-			BoxInfo.Value.Location,
-			BoxInfo.Value.BoxExtent,
-			FQuat(BoxInfo.Value.Rotation),
-			Color,
-			true
-		);
+		LagCompensationSubsystem->Unregister(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+float ULagCompensationComponent::GetMinRecordInterval() const
+{
+	// A dedicated server ticks no faster than NetServerMaxTickRate but a listen server host isn't capped,
+	// so frames are paced to the tick rate instead. A little under a tick, a capped server's ticks can come in early
+	float TickRate = DefaultServerTickRate;
+	UWorld* World = GetWorld();
+	if (World && World->GetNetDriver() && World->GetNetDriver()->GetNetServerMaxTickRate() > 0)
+	{
+		TickRate = World->GetNetDriver()->GetNetServerMaxTickRate();
 	}
+	return 0.8f / TickRate;
+}
+
+int32 ULagCompensationComponent::GetHistoryCapacity() const
+{
+	// every frame MaxRecordTime can hold at the closest they're recorded, plus the one kept before the window
+	return FMath::CeilToInt(MaxRecordTime / GetMinRecordInterval()) + 2;
 }
 
 void ULagCompensationComponent::ShowFramePackageCapsule(const FFramePackageCapsule& Package, const FColor& Color)
 {
-	for (auto& CapsuleInfo : Package.HitCapsulesInfo)
+	for (int32 i = 0; i < Package.NumCapsules(); ++i)
 	{
+		const FCapsuleInformation CapsuleInfo = Package.GetCapsule(i);
 		DrawDebugSphere(
 			GetWorld(),
 			CapsuleInfo.A,
@@ -63,703 +169,491 @@ void ULagCompensationComponent::ShowFramePackageCapsule(const FFramePackageCapsu
 	}
 }
 
-FServerSideRewindResult ULagCompensationComponent::ServerSideRewind(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation, float HitTime)
-{
-	FFramePackage FrameToCheck = GetFrameToCheck(HitCharacter, HitTime);
-	return ConfirmHit(FrameToCheck, HitCharacter, TraceStart, HitLocation);
-}
-
-FServerSideRewindResultCapsule ULagCompensationComponent::ServerSideRewindCapsule(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation, float HitTime)
-{
-	FFramePackageCapsule FrameToCheck = GetFrameToCheckCapsule(HitCharacter, HitTime);
-	return ConfirmHitCapsule(FrameToCheck, HitCharacter, TraceStart, HitLocation);
-}
-
-FServerSideRewindResult ULagCompensationComponent::ProjectileServerSideRewind(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize100& InitialVelocity, float HitTime)
-{
-	FFramePackage FrameToCheck = GetFrameToCheck(HitCharacter, HitTime);
-	return ProjectileConfirmHit(FrameToCheck, HitCharacter, TraceStart, InitialVelocity, HitTime);
-}
-
-FShotgunServerSideRewindResult ULagCompensationComponent::ShotgunServerSideRewind(const TArray<ABlasterCharacter*>& HitCharacters, const FVector_NetQuantize& TraceStart, const TArray<FVector_NetQuantize>& HitLocations, float HitTime)
-{
-	TArray<FFramePackage> FramesToCheck;
-	for (ABlasterCharacter* HitCharacter : HitCharacters)
-	{
-		FramesToCheck.Add(GetFrameToCheck(HitCharacter, HitTime));
-	}
-
-	return ShotgunConfirmHit(FramesToCheck, TraceStart, HitLocations);
-}
-
-FFramePackage ULagCompensationComponent::GetFrameToCheck(ABlasterCharacter* HitCharacter, float HitTime)
+bool ULagCompensationComponent::ConfirmShotgunPellets(TArrayView<FRewindVictim> Victims, const FVector& TraceStart, TArrayView<const FVector> TraceEnds, FShotgunServerSideRewindResult& OutResult, ULagCompensationSubsystem* Capture)
 {
-	bool bReturn =
-		HitCharacter == nullptr ||
-		HitCharacter->GetLagCompensation() == nullptr ||
-		HitCharacter->GetLagCompensation()->FrameHistory.GetHead() == nullptr ||
-		HitCharacter->GetLagCompensation()->FrameHistory.GetTail() == nullptr;
-	if (bReturn) return FFramePackage();
-
-	// Frame package that we check to verify a hit
-	FFramePackage FrameToCheck;
-	bool bShouldInterpolate = true;
-
-	// Frame history of the HitCharacter
-	const TDoubleLinkedList<FFramePackage>& History = HitCharacter->GetLagCompensation()->FrameHistory;
-	const float OldestHistoryTime = History.GetTail()->GetValue().Time;
-	const float NewestHistoryTime = History.GetHead()->GetValue().Time;
-	if (OldestHistoryTime > HitTime)
-	{
-		// too far back - too laggy to do SSR
-		return FFramePackage();
-	}
-	if (OldestHistoryTime == HitTime)
-	{
-		FrameToCheck = History.GetTail()->GetValue();
-		bShouldInterpolate = false;
-	}
-	if (NewestHistoryTime <= HitTime)
+	OutResult.Victims.Reset(Victims.Num());
+	for (const FRewindVictim& Victim : Victims)
 	{
-		FrameToCheck = History.GetHead()->GetValue();
-		bShouldInterpolate = false;
+		OutResult.Victims.Add(Victim.Character);
 	}
+	OutResult.HitCounts.Reset();
+	OutResult.HitCounts.SetNumZeroed(Victims.Num() * FShotgunServerSideRewindResult::NumHitboxTypes);
 
-	TDoubleLinkedList<FFramePackage>::TDoubleLinkedListNode* Younger = History.GetHead();
-	TDoubleLinkedList<FFramePackage>::TDoubleLinkedListNode* Older = Younger;
-
-	while (Older->GetValue().Time > HitTime) // is Older still younger than HitTime
+	// every victim is rewound once, its capsules are lerped a group at a time the first time any pellet reaches them
+	bool bHit = false;
+	for (const FVector& TraceEnd : TraceEnds)
 	{
-		// March back until: OlderTime < HitTime < YoungerTime
-		if (Older->GetNextNode() == nullptr) break;
-		Older = Older->GetNextNode();
-		if (Older->GetValue().Time > HitTime)
+		// a pellet hits the nearest character it touches
+		int32 HitVictim = INDEX_NONE;
+		EHitbox HitType = EHitbox::EH_None;
+		double HitDistance = TNumericLimits<double>::Max();
+		for (int32 VictimIndex = 0; VictimIndex < Victims.Num(); ++VictimIndex)
 		{
-			Younger = Older;
+			const FHitInfo HitInfo = TraceAgainstCapsules(Victims[VictimIndex].Bracket, TraceStart, TraceEnd);
+			if (Capture)
+			{
+				Capture->CaptureRewind(Victims[VictimIndex].Bracket, TraceStart, TraceEnd, 0.f, HitInfo.HitType, HitInfo.Location, HitInfo.Normal);
+			}
+			if (HitInfo.HitType == EHitbox::EH_None) continue;
+			const double Distance = FVector::DistSquared(TraceStart, HitInfo.Location);
+			if (Distance < HitDistance)
+			{
+				HitDistance = Distance;
+				HitVictim = VictimIndex;
+				HitType = HitInfo.HitType;
+			}
 		}
+
+		if (HitVictim == INDEX_NONE) continue;
+		++OutResult.HitCounts[HitVictim * FShotgunServerSideRewindResult::NumHitboxTypes + static_cast<int32>(HitType)];
+		bHit = true;
 	}
-	if (Older->GetValue().Time == HitTime) // highly unlikely, but we found our frame to check
-	{
-		FrameToCheck = Older->GetValue();
-		bShouldInterpolate = false;
-	}
-	if (bShouldInterpolate)
-	{
-		// Interpolate between Younger and Older
-		FrameToCheck = InterpBetweenFrames(Older->GetValue(), Younger->GetValue(), HitTime);
-	}
-	FrameToCheck.Character = HitCharacter;
-	return FrameToCheck;
+	return bHit;
 }
 
-FFramePackageCapsule ULagCompensationComponent::GetFrameToCheckCapsule(ABlasterCharacter* HitCharacter, float HitTime)
+bool ULagCompensationComponent::GetFrameBracketCapsule(ABlasterCharacter* HitCharacter, float HitTime, FCapsuleFrameBracket& OutBracket)
 {
-	bool bReturn =
-		HitCharacter == nullptr ||
-		HitCharacter->GetLagCompensation() == nullptr ||
-		HitCharacter->GetLagCompensation()->FrameHistoryCapsule.GetHead() == nullptr ||
-		HitCharacter->GetLagCompensation()->FrameHistoryCapsule.GetTail() == nullptr;
-	if (bReturn) return FFramePackageCapsule();
-
-	// Frame package that we check to verify a hit
-	FFramePackageCapsule FrameToCheck;
-	bool bShouldInterpolate = true;
-
-	// Frame history of the HitCharacter
-	const TDoubleLinkedList<FFramePackageCapsule>& History = HitCharacter->GetLagCompensation()->FrameHistoryCapsule;
-	const float OldestHistoryTime = History.GetTail()->GetValue().Time;
-	const float NewestHistoryTime = History.GetHead()->GetValue().Time;
-
-	if (OldestHistoryTime > HitTime)
-	{
-		// too far back - too laggy to do SSR
-		return FFramePackageCapsule();
-	}
-	if (OldestHistoryTime == HitTime)
-	{
-		FrameToCheck = History.GetTail()->GetValue();
-		bShouldInterpolate = false;
-	}
-	if (NewestHistoryTime <= HitTime)
-	{
-		FrameToCheck = History.GetHead()->GetValue();
-		bShouldInterpolate = false;
-	}
-
-	TDoubleLinkedList<FFramePackageCapsule>::TDoubleLinkedListNode* Younger = History.GetHead();
-	TDoubleLinkedList<FFramePackageCapsule>::TDoubleLinkedListNode* Older = Younger;
-
-	while (Older->GetValue().Time > HitTime) // is Older still younger than HitTime
-	{
-		// March back until: OlderTime < HitTime < YoungerTime
-		if (Older->GetNextNode() == nullptr) break;
-		Older = Older->GetNextNode();
-		if (Older->GetValue().Time > HitTime)
-		{
-			Younger = Older;
-		}
-	}
-	if (Older->GetValue().Time == HitTime) // highly unlikely, but we found our frame to check
-	{
-		FrameToCheck = Older->GetValue();
-		bShouldInterpolate = false;
-	}
-	if (bShouldInterpolate)
-	{
-		// Interpolate between Younger and Older
-		FrameToCheck = InterpBetweenFramesCapsule(Older->GetValue(), Younger->GetValue(), HitTime);
-	}
-	FrameToCheck.Character = HitCharacter;
-	return FrameToCheck;
+	return LagCompensationSubsystem && LagCompensationSubsystem->GetFrameBracket(HitCharacter, HitTime, OutBracket);
 }
 
-void ULagCompensationComponent::ServerScoreRequest_Implementation(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation, float HitTime, AWeapon* DamageCauser)
+void ULagCompensationComponent::ServerScoreRequestCapsule_Implementation(const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitTarget, uint16 ShotSequence, float HitTime, AWeapon* DamageCauser)
 {
-	DamageCauserWeapon = DamageCauser;
-	FServerSideRewindResult Confirm = ServerSideRewind(HitCharacter, TraceStart, HitLocation, HitTime);
+	// only the equipped weapon scores, a client can't claim the damage of another weapon it happens to know about
+	if (DamageCauser == nullptr || Character == nullptr || DamageCauser != Character->GetEquippedWeapon()) return;
+	if (!IsValidTraceStart(TraceStart)) return;
+	if (!AcceptScoredShot(DamageCauser, HitTarget, ShotSequence)) return;
+	if (!ConsumeRequestBudget(1)) return;
 
-	if (Character && HitCharacter && DamageCauser && Confirm.bHitConfirmed)
-	{
-		UGameplayStatics::ApplyDamage(
-			HitCharacter,
-			DamageCauser->GetDamage(),
-			Character->Controller,
-			DamageCauser,
-			UDamageType::StaticClass()
-		);
-	}
+	// rewound in ProcessScoreRequests, together with any other requests that arrive this tick
+	const FVector HitLocation = DamageCauser->bUseScatter ? DamageCauser->TraceEndWithScatter(TraceStart, HitTarget, ShotSequence) : FVector(HitTarget);
+	PendingScoreRequests.Add(FCapsuleScoreRequest{ TraceStart, HitLocation, HitTime, DamageCauser, DamageCauser->bUseScatter });
 }
 
-void ULagCompensationComponent::ServerScoreRequestCapsule_Implementation(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation, float HitTime, AWeapon* DamageCauser)
+bool ULagCompensationComponent::AcceptScoredShot(AWeapon* Weapon, const FVector_NetQuantize& HitTarget, uint16 ShotSequence)
 {
-	DamageCauserWeapon = DamageCauser;
-	FServerSideRewindResultCapsule Confirm = ServerSideRewindCapsule(HitCharacter, TraceStart, HitLocation, HitTime);
+	if (Character == nullptr || Character->GetCombat() == nullptr) return false;
 
-	if (Character && HitCharacter && DamageCauser && Confirm.HitType != EHitbox::EH_None)
-	{
-		UGameplayStatics::ApplyDamage(
-			HitCharacter,
-			FHitbox::GetDamage(Confirm.HitType, DamageCauser->GetDamage()),
-			Character->Controller,
-			DamageCauser,
-			UDamageType::StaticClass()
-		);
-		HitCharacter->Multicast_SpawnBlood(Confirm.HitLocation, -Confirm.HitNormal, DamageCauser->GetWeaponType());
-	}
+	// a repeat of an accepted shot is dropped here, ConsumeScorableShot still finds it
+	Character->GetCombat()->AcceptFireEvent(Weapon, FFireEvent{ HitTarget, ShotSequence });
+	return Weapon->ConsumeScorableShot(ShotSequence);
 }
 
-void ULagCompensationComponent::ProjectileServerScoreRequest_Implementation(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize100& InitialVelocity, float HitTime)
+bool ULagCompensationComponent::ConsumeRequestBudget(int32 Traces)
 {
-	FServerSideRewindResult Confirm = ProjectileServerSideRewind(HitCharacter, TraceStart, InitialVelocity, HitTime);
+	if (LagCompensationSubsystem == nullptr || Character == nullptr) return false;
 
-	if (Character && Character->GetEquippedWeapon() && HitCharacter && Confirm.bHitConfirmed)
-	{
-		UGameplayStatics::ApplyDamage(
-			HitCharacter,
-			Character->GetEquippedWeapon()->GetDamage(),
-			Character->Controller,
-			Character->GetEquippedWeapon(),
-			UDamageType::StaticClass()
-		);
-	}
+	// the most traces a second the equipped weapon can legitimately ask for
+	const AWeapon* Weapon = Character->GetEquippedWeapon();
+	if (Weapon == nullptr || Weapon->FireDelay <= 0.f) return false;
+	const float Rate = Weapon->GetTracesPerShot() / Weapon->FireDelay;
+	return LagCompensationSubsystem->ConsumeScoreRequestBudget(Character, Traces, Rate, ScoreRequestBurst);
 }
 
-void ULagCompensationComponent::ShotgunServerScoreRequest_Implementation(const TArray<ABlasterCharacter*>& HitCharacters, const FVector_NetQuantize& TraceStart, const TArray<FVector_NetQuantize>& HitLocations, float HitTime, AWeapon* DamageCauser)
+void ULagCompensationComponent::ProcessScoreRequests()
 {
-	DamageCauserWeapon = DamageCauser;
-	FShotgunServerSideRewindResult Confirm = ShotgunServerSideRewind(HitCharacters, TraceStart, HitLocations, HitTime);
+	if (PendingScoreRequests.IsEmpty() && PendingShotgunRequests.IsEmpty() && PendingProjectileRequests.IsEmpty()) return;
+	TRACE_CPUPROFILER_EVENT_SCOPE(SSR_Confirm);
+	SCOPE_CYCLE_COUNTER(STAT_SSRConfirmHits);
 
-	if (DamageCauser == nullptr || Character == nullptr) return;
+	struct FRewindBatch
+	{
+		ABlasterCharacter* HitCharacter = nullptr;
+		float HitTime = 0.f;
+		FCapsuleFrameBracket Bracket;
+		// the history lookup, shared by every request in the batch
+		uint64 Cycles = 0;
+	};
+	// one request traced against one of the characters it can reach
+	struct FRewindTest
+	{
+		int32 Request = INDEX_NONE;
+		int32 Batch = INDEX_NONE;
+		FServerSideRewindResultCapsule Result;
+		uint64 Cycles = 0;
+	};
+	// one shotgun request, every character its pellets reach rewound once
+	struct FShotgunShot
+	{
+		TArray<FRewindVictim, TInlineAllocator<4>> Victims;
+		FShotgunServerSideRewindResult Result;
+		EScoreRequestOutcome Outcome = EScoreRequestOutcome::Miss;
+		uint64 Cycles = 0;
+	};
+	// one projectile request, rewound along its arc
+	struct FProjectileShot
+	{
+		int32 Track = INDEX_NONE;
+		FServerSideRewindResultCapsule Result;
+		EScoreRequestOutcome Outcome = EScoreRequestOutcome::NoHistory;
+		uint64 Cycles = 0;
+	};
+	TArray<FRewindBatch, TInlineAllocator<4>> Batches;
+	TArray<FRewindTest, TInlineAllocator<16>> Tests;
+	TArray<FVector, TInlineAllocator<8>> TraceEnds;
+	TraceEnds.SetNumUninitialized(PendingScoreRequests.Num());
+	TArray<EScoreRequestOutcome, TInlineAllocator<8>> Outcomes;
+	Outcomes.Init(EScoreRequestOutcome::Miss, PendingScoreRequests.Num());
+	// cycles each hitscan request cost, its batches' lookups and traces are added in once they're done
+	TArray<uint64, TInlineAllocator<8>> RequestCycles;
+	RequestCycles.SetNumZeroed(PendingScoreRequests.Num());
+	const float Now = GetWorld()->GetTimeSeconds();
 
-	for (auto& HitCharacter : HitCharacters)
+	// Each trace stops at the first static geometry it meets, one cached trace that spares rewinding anybody behind a wall.
+	// A claimed hit that is itself behind the wall is occluded outright. The server then finds who each trace can reach
+	// and groups the rewinds by victim, a batch is rewound to the HitTime of its first request
+	TArray<FRewindCandidate, TInlineAllocator<8>> Candidates;
+	for (int32 i = 0; i < PendingScoreRequests.Num(); ++i)
 	{
-		if (HitCharacter == nullptr) continue;
-		float TotalDamage = 0.f;
-		if (Confirm.HeadShots.Contains(HitCharacter))
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		const FCapsuleScoreRequest& Request = PendingScoreRequests[i];
+		const FVector TraceEnd = ClipToStaticGeometry(Request.TraceStart, Request.TraceStart + (Request.HitLocation - Request.TraceStart) * 1.25f);
+		TraceEnds[i] = TraceEnd;
+		if (!Request.bScattered && FVector::DistSquared(Request.TraceStart, TraceEnd) < FVector::DistSquared(Request.TraceStart, Request.HitLocation))
 		{
-			float HeadShotDamage = Confirm.HeadShots[HitCharacter] * DamageCauser->GetDamage();
-			TotalDamage += HeadShotDamage;
+			Outcomes[i] = EScoreRequestOutcome::Occluded;
+			RequestCycles[i] += FPlatformTime::Cycles64() - StartCycles;
+			continue;
 		}
-		if (Confirm.BodyShots.Contains(HitCharacter))
+		const int32 Unrewound = LagCompensationSubsystem->FindRewindCandidates(Request.TraceStart, TraceEnd, Request.HitTime, Character, Candidates);
+		if (Candidates.IsEmpty() && Unrewound > 0)
 		{
-			float BodyShotDamage = Confirm.BodyShots[HitCharacter] * DamageCauser->GetDamage();
-			TotalDamage += BodyShotDamage;
+			Outcomes[i] = Now - Request.HitTime > MaxRecordTime ? EScoreRequestOutcome::TooOld : EScoreRequestOutcome::NoHistory;
 		}
-		UGameplayStatics::ApplyDamage(
-			HitCharacter,
-			TotalDamage,
-			Character->Controller,
-			DamageCauser,
-			UDamageType::StaticClass()
-		);
-	}
-}
 
-FFramePackage ULagCompensationComponent::InterpBetweenFrames(const FFramePackage& OlderFrame, const FFramePackage& YoungerFrame, float HitTime)
-{
-	const float Distance = YoungerFrame.Time - OlderFrame.Time;
-	const float InterpFraction = FMath::Clamp((HitTime - OlderFrame.Time) / Distance, 0.f, 1.f);
-
-	FFramePackage InterpFramePackage;
-	InterpFramePackage.Time = HitTime;
+		for (const FRewindCandidate& Candidate : Candidates)
+		{
+			int32 BatchIndex = Batches.IndexOfByPredicate([&](const FRewindBatch& Batch)
+				{
+					return Batch.HitCharacter == Candidate.Character && FMath::Abs(Batch.HitTime - Request.HitTime) <= RewindBatchTimeTolerance;
+				});
+			if (BatchIndex == INDEX_NONE)
+			{
+				BatchIndex = Batches.AddDefaulted();
+				Batches[BatchIndex].HitCharacter = Candidate.Character;
+				Batches[BatchIndex].HitTime = Request.HitTime;
+			}
+			Tests.Add(FRewindTest{ i, BatchIndex });
+		}
+		RequestCycles[i] += FPlatformTime::Cycles64() - StartCycles;
+	}
 
-	for (auto& YoungerPair : YoungerFrame.HitBoxInfo)
+	// history lookups touch the victims, so they stay on the game thread
+	for (FRewindBatch& Batch : Batches)
 	{
-		const FName& BoxInfoName = YoungerPair.Key;
-
-		const FBoxInformation& OlderBox = OlderFrame.HitBoxInfo[BoxInfoName];
-		const FBoxInformation& YoungerBox = YoungerFrame.HitBoxInfo[BoxInfoName];
-
-		FBoxInformation InterpBoxInfo;
-
-		InterpBoxInfo.Location = FMath::VInterpTo(OlderBox.Location, YoungerBox.Location, 1.f, InterpFraction);
-		InterpBoxInfo.Rotation = FMath::RInterpTo(OlderBox.Rotation, YoungerBox.Rotation, 1.f, InterpFraction);
-		InterpBoxInfo.BoxExtent = YoungerBox.BoxExtent;
-
-		InterpFramePackage.HitBoxInfo.Add(BoxInfoName, InterpBoxInfo);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		GetFrameBracketCapsule(Batch.HitCharacter, Batch.HitTime, Batch.Bracket);
+		Batch.Cycles = FPlatformTime::Cycles64() - StartCycles;
 	}
 
-	return InterpFramePackage;
-}
-
-FFramePackageCapsule ULagCompensationComponent::InterpBetweenFramesCapsule(const FFramePackageCapsule& OlderFrame, const FFramePackageCapsule& YoungerFrame, float HitTime)
-{
-	const float Distance = YoungerFrame.Time - OlderFrame.Time;
-	const float InterpFraction = FMath::Clamp((HitTime - OlderFrame.Time) / Distance, 0.f, 1.f);
-
-	FFramePackageCapsule InterpFramePackage;
-	InterpFramePackage.Time = HitTime;
-
-	// assumes that physics asset holds SphylElems in the same order
-	for (int i = 0; i < YoungerFrame.HitCapsulesInfo.Num(); ++i)
+	TArray<FShotgunShot, TInlineAllocator<2>> ShotgunShots;
+	ShotgunShots.SetNum(PendingShotgunRequests.Num());
+	for (int32 i = 0; i < PendingShotgunRequests.Num(); ++i)
 	{
-		const FCapsuleInformation& OlderCapsule = OlderFrame.HitCapsulesInfo[i];
-		const FCapsuleInformation& YoungerCapsule = YoungerFrame.HitCapsulesInfo[i];
-
-		FCapsuleInformation InterpCapsuleInfo;
-		InterpCapsuleInfo.A = FMath::VInterpTo(OlderCapsule.A, YoungerCapsule.A, 1.f, InterpFraction);
-		InterpCapsuleInfo.B = FMath::VInterpTo(OlderCapsule.B, YoungerCapsule.B, 1.f, InterpFraction);
-		InterpCapsuleInfo.Radius = YoungerCapsule.Radius;
-		InterpCapsuleInfo.Length = YoungerCapsule.Length;
-		InterpCapsuleInfo.HitboxType = YoungerCapsule.HitboxType;
-		
-		InterpFramePackage.HitCapsulesInfo.Add(InterpCapsuleInfo);
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		const FShotgunScoreRequest& Request = PendingShotgunRequests[i];
+		FShotgunShot& Shot = ShotgunShots[i];
+		const int32 Unrewound = LagCompensationSubsystem->FindRewindVictims(Request.TraceStart, Request.TraceEnds, Request.HitTime, Character, Shot.Victims);
+		Shot.Cycles = FPlatformTime::Cycles64() - StartCycles;
+		if (Shot.Victims.IsEmpty() && Unrewound > 0)
+		{
+			Shot.Outcome = Now - Request.HitTime > MaxRecordTime ? EScoreRequestOutcome::TooOld : EScoreRequestOutcome::NoHistory;
+		}
 	}
-	return InterpFramePackage;
-}
 
-FServerSideRewindResult ULagCompensationComponent::ConfirmHit(const FFramePackage& Package, ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation)
-{
-	if (HitCharacter == nullptr) return FServerSideRewindResult();
-	
-	FFramePackage CurrentFrame;
-	CacheBoxPositions(HitCharacter, CurrentFrame);
-	MoveBoxes(HitCharacter, Package);
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::NoCollision);
-	//ShowFramePackage(Package, FColor::Black);
-
-	// Enable collision for the head first
-	UBoxComponent* HeadBox = HitCharacter->HitCollisionBoxes[FName("head")];
-	HeadBox->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-	HeadBox->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
-
-	FHitResult ConfirmHitResult;
-	const FVector TraceEnd = TraceStart + (HitLocation - TraceStart) * 1.25f;
-	//TraceAgainstCapsules(TraceStart, TraceEnd, HitCharacter);
-	UWorld* World = GetWorld();
-	if (World && DamageCauserWeapon)
+	TArray<FProjectileShot, TInlineAllocator<2>> ProjectileShots;
+	ProjectileShots.SetNum(PendingProjectileRequests.Num());
+	for (int32 i = 0; i < PendingProjectileRequests.Num(); ++i)
 	{
-		World->LineTraceSingleByChannel(
-			ConfirmHitResult,
-			TraceStart,
-			TraceEnd,
-			ECC_PlayerHitBox,
-			DamageCauserWeapon->GetTraceQueryParams()
-		);
-		DrawDebugLine(World, TraceStart, TraceEnd, FColor::Cyan, true);
-		if (ConfirmHitResult.bBlockingHit) // we hit the head, return early
+		const ABlasterCharacter* HitCharacter = PendingProjectileRequests[i].HitCharacter.Get();
+		if (HitCharacter && HitCharacter->GetLagCompensation())
 		{
-			ResetHitBoxes(HitCharacter, CurrentFrame);
-			EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-			return FServerSideRewindResult{ true, true };
+			ProjectileShots[i].Track = HitCharacter->GetLagCompensation()->RewindTrack;
 		}
-		else // didn't hit the head, check the rest of the boxes
+	}
+
+	// The rewinds only read saved frames, each work item writes only its own results: hitscan batches,
+	// then shotgun shots, then projectiles. Captures aren't thread safe, so everything stays on the game thread while recording one.
+	const bool bCapturing = LagCompensationSubsystem->IsCapturingRewinds();
+	const float GravityZ = GetWorld()->GetGravityZ();
+	const int32 NumWorkItems = Batches.Num() + ShotgunShots.Num() + ProjectileShots.Num();
+	ParallelFor(NumWorkItems, [&](int32 WorkIndex)
 		{
-			for (auto& HitBoxPair : HitCharacter->HitCollisionBoxes)
+			if (WorkIndex < Batches.Num())
 			{
-				if (HitBoxPair.Value != nullptr)
+				FRewindBatch& Batch = Batches[WorkIndex];
+				if (!Batch.Bracket.IsValid()) return;
+
+				for (FRewindTest& Test : Tests)
 				{
-					HitBoxPair.Value->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-					HitBoxPair.Value->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
+					if (Test.Batch != WorkIndex) continue;
+					const uint64 StartCycles = FPlatformTime::Cycles64();
+					const FCapsuleScoreRequest& Request = PendingScoreRequests[Test.Request];
+					const FHitInfo HitInfo = TraceAgainstCapsules(Batch.Bracket, Request.TraceStart, TraceEnds[Test.Request]);
+					Test.Result = FServerSideRewindResultCapsule{ HitInfo.HitType, HitInfo.Location, HitInfo.Normal };
+					Test.Cycles = FPlatformTime::Cycles64() - StartCycles;
 				}
+				return;
 			}
-			World->LineTraceSingleByChannel(
-				ConfirmHitResult,
-				TraceStart,
-				TraceEnd,
-				ECC_PlayerHitBox,
-				DamageCauserWeapon->GetTraceQueryParams()
-			);
-			DrawDebugLine(World, TraceStart, TraceEnd, FColor::Cyan, true);
-			if (ConfirmHitResult.bBlockingHit)
+
+			WorkIndex -= Batches.Num();
+			if (WorkIndex < ShotgunShots.Num())
 			{
-				ResetHitBoxes(HitCharacter, CurrentFrame);
-				EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-				return FServerSideRewindResult{ true, false };
+				FShotgunShot& Shot = ShotgunShots[WorkIndex];
+				if (Shot.Victims.IsEmpty()) return;
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				const FShotgunScoreRequest& Request = PendingShotgunRequests[WorkIndex];
+				const bool bHit = ConfirmShotgunPellets(Shot.Victims, Request.TraceStart, Request.TraceEnds, Shot.Result, bCapturing ? LagCompensationSubsystem : nullptr);
+				Shot.Outcome = bHit ? EScoreRequestOutcome::Hit : EScoreRequestOutcome::Miss;
+				Shot.Cycles += FPlatformTime::Cycles64() - StartCycles;
+				return;
 			}
+
+			WorkIndex -= ShotgunShots.Num();
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			FProjectileShot& Shot = ProjectileShots[WorkIndex];
+			const FProjectileScoreRequest& Request = PendingProjectileRequests[WorkIndex];
+			bool bRewound;
+			Shot.Result = ProjectileConfirmHit(Shot.Track, Request.TraceStart, Request.InitialVelocity, Request.FireTime, Now, GravityZ, bRewound, bCapturing ? LagCompensationSubsystem : nullptr);
+			// the rewind depth of a projectile is how long ago it was fired
+			Shot.Outcome = Shot.Result.HitType != EHitbox::EH_None ? EScoreRequestOutcome::Hit
+				: bRewound ? EScoreRequestOutcome::Miss
+				: Now - Request.FireTime > MaxRecordTime ? EScoreRequestOutcome::TooOld : EScoreRequestOutcome::NoHistory;
+			Shot.Cycles = FPlatformTime::Cycles64() - StartCycles;
+		},
+		NumWorkItems < ParallelRewindMinBatches || bCapturing ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None
+	);
+
+	if (bCapturing)
+	{
+		for (const FRewindTest& Test : Tests)
+		{
+			const FRewindBatch& Batch = Batches[Test.Batch];
+			const FServerSideRewindResultCapsule& Result = Test.Result;
+			LagCompensationSubsystem->CaptureRewind(Batch.Bracket, PendingScoreRequests[Test.Request].TraceStart, TraceEnds[Test.Request], 0.f, Result.HitType, Result.HitLocation, Result.HitNormal);
 		}
 	}
-	ResetHitBoxes(HitCharacter, CurrentFrame);
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-	return FServerSideRewindResult{ false, false };
-}
 
-FServerSideRewindResultCapsule ULagCompensationComponent::ConfirmHitCapsule(const FFramePackageCapsule& Package, ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitLocation)
-{
-	if (HitCharacter == nullptr) return FServerSideRewindResultCapsule();
-	
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::NoCollision);
-
-	const FVector TraceEnd = TraceStart + (HitLocation - TraceStart) * 1.25f;
-	FHitInfo HitInfo = TraceAgainstCapsules(Package, HitCharacter, TraceStart, TraceEnd);
-
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-	return FServerSideRewindResultCapsule{HitInfo.HitType, HitInfo.Location, HitInfo.Normal};
-}
-
-FServerSideRewindResult ULagCompensationComponent::ProjectileConfirmHit(const FFramePackage& Package, ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize100& InitialVelocity, float HitTime)
-{
-	if (HitCharacter == nullptr) return FServerSideRewindResult();
-
-	FFramePackage CurrentFrame;
-	CacheBoxPositions(HitCharacter, CurrentFrame);
-	MoveBoxes(HitCharacter, Package);
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::NoCollision);
-	//ShowFramePackage(Package, FColor::Black);
-
-	// Enable collision for the head first
-	UBoxComponent* HeadBox = HitCharacter->HitCollisionBoxes[FName("head")];
-	HeadBox->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-	HeadBox->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
-
-	FPredictProjectilePathParams PathParams;
-	PathParams.bTraceWithCollision = true;
-	PathParams.MaxSimTime = MaxRecordTime;
-	PathParams.LaunchVelocity = InitialVelocity;
-	PathParams.StartLocation = TraceStart;
-	PathParams.SimFrequency = 10.f;
-	PathParams.ProjectileRadius = 5.f;
-	PathParams.TraceChannel = ECC_PlayerHitBox;
-	PathParams.ActorsToIgnore.Add(GetOwner());
-	PathParams.DrawDebugTime = 5.f;
-	PathParams.DrawDebugType = EDrawDebugTrace::ForDuration;
-
-	FPredictProjectilePathResult PathResult;
-	UGameplayStatics::PredictProjectilePath(this, PathParams, PathResult);
-
-	if (PathResult.HitResult.bBlockingHit) // we hit the head, return early
+	// Damage is applied on the game thread, in arrival order within each kind of request.
+	// Hitscan first, each request hits the nearest character it actually touches
+	for (int32 i = 0; i < PendingScoreRequests.Num(); ++i)
 	{
-		ResetHitBoxes(HitCharacter, CurrentFrame);
-		EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-		return FServerSideRewindResult{ true, true };
-	}
-	else // we didn't hit the head; check the rest of the boxes
-	{
-		for (auto& HitBoxPair : HitCharacter->HitCollisionBoxes)
+		const FCapsuleScoreRequest& Request = PendingScoreRequests[i];
+		const FRewindTest* Hit = nullptr;
+		double HitDistanceSquared = TNumericLimits<double>::Max();
+		for (const FRewindTest& Test : Tests)
 		{
-			if (HitBoxPair.Value != nullptr)
+			if (Test.Request != i || Test.Result.HitType == EHitbox::EH_None) continue;
+			const double DistanceSquared = FVector::DistSquared(Request.TraceStart, Test.Result.HitLocation);
+			if (DistanceSquared < HitDistanceSquared)
 			{
-				HitBoxPair.Value->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-				HitBoxPair.Value->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
+				Hit = &Test;
+				HitDistanceSquared = DistanceSquared;
 			}
 		}
-
-		UGameplayStatics::PredictProjectilePath(this, PathParams, PathResult);
-		if (PathResult.HitResult.bBlockingHit)
+		if (Hit == nullptr) continue;
+
+		// Refines the early clip with the rewound hit: only static geometry between the shooter and it rules the hit out,
+		// whatever is behind the victim doesn't matter. A scattered HitLocation is far past the victim, so this can't trace to it
+		const FServerSideRewindResultCapsule& Confirm = Hit->Result;
+		const double HitDistance = FMath::Sqrt(HitDistanceSquared);
+		const uint64 OcclusionCycles = FPlatformTime::Cycles64();
+		const bool bOccluded = LagCompensationSubsystem->GetStaticOcclusion(Request.TraceStart, Confirm.HitLocation) * HitDistance + OcclusionTolerance < HitDistance;
+		RequestCycles[i] += FPlatformTime::Cycles64() - OcclusionCycles;
+		if (bOccluded)
 		{
-			ResetHitBoxes(HitCharacter, CurrentFrame);
-			EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-			return FServerSideRewindResult{ true, false };
+			Outcomes[i] = EScoreRequestOutcome::Occluded;
+			continue;
 		}
-	}
-
-	ResetHitBoxes(HitCharacter, CurrentFrame);
-	EnableCharacterMeshCollision(HitCharacter, ECollisionEnabled::QueryAndPhysics);
-	return FServerSideRewindResult{ false, false };
-}
+		Outcomes[i] = EScoreRequestOutcome::Hit;
 
-FShotgunServerSideRewindResult ULagCompensationComponent::ShotgunConfirmHit(const TArray<FFramePackage>& FramePackages, const FVector_NetQuantize& TraceStart, const TArray<FVector_NetQuantize>& HitLocations)
-{
-	for (auto& Frame : FramePackages)
-	{
-		if (Frame.Character == nullptr) return FShotgunServerSideRewindResult();
-	}
-	FShotgunServerSideRewindResult ShotgunResult;
-	TArray<FFramePackage> CurrentFrames;
-	for (auto& Frame : FramePackages)
-	{
-		FFramePackage CurrentFrame;
-		CurrentFrame.Character = Frame.Character;
-		CacheBoxPositions(Frame.Character, CurrentFrame);
-		MoveBoxes(Frame.Character, Frame);
-		EnableCharacterMeshCollision(Frame.Character, ECollisionEnabled::NoCollision);
-		CurrentFrames.Add(CurrentFrame);
-	}
-
-	for (auto& Frame : FramePackages)
-	{
-		// Enable collision for the head first
-		UBoxComponent* HeadBox = Frame.Character->HitCollisionBoxes[FName("head")];
-		HeadBox->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-		HeadBox->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
-	}
-
-	UWorld* World = GetWorld();
-	// check for headshots
-	for (auto& HitLocation : HitLocations)
-	{
-		FHitResult ConfirmHitResult;
-		const FVector TraceEnd = TraceStart + (HitLocation - TraceStart) * 1.25f;
-		if (World && DamageCauserWeapon)
+		ABlasterCharacter* HitCharacter = Batches[Hit->Batch].HitCharacter;
+		AWeapon* DamageCauser = Request.DamageCauser.Get();
+		if (Character && IsValid(HitCharacter) && DamageCauser)
 		{
-			World->LineTraceSingleByChannel(
-				ConfirmHitResult,
-				TraceStart,
-				TraceStart + TraceEnd,
-				ECC_PlayerHitBox,
-				DamageCauserWeapon->GetTraceQueryParams()
+			UGameplayStatics::ApplyDamage(
+				HitCharacter,
+				FHitbox::GetDamage(Confirm.HitType, DamageCauser->GetDamage()),
+				Character->Controller,
+				DamageCauser,
+				UDamageType::StaticClass()
 			);
-			ABlasterCharacter* BlasterCharacter = Cast<ABlasterCharacter>(ConfirmHitResult.GetActor());
-			if (BlasterCharacter)
-			{
-				if (ShotgunResult.HeadShots.Contains(BlasterCharacter))
-				{
-					ShotgunResult.HeadShots[BlasterCharacter]++;
-				}
-				else
-				{
-					ShotgunResult.HeadShots.Emplace(BlasterCharacter, 1);
-				}
-			}
+			HitCharacter->Multicast_SpawnBlood(Confirm.HitLocation, -Confirm.HitNormal, DamageCauser->GetWeaponType());
 		}
 	}
 
-	// enable collision for all boxes, then disable for head box
-	for (auto& Frame : FramePackages)
+	// then shotgun shots, one damage event per victim for all of its pellets. Every pellet does the shotgun's flat damage,
+	// like AShotgun::FireShotgun on the server
+	for (int32 i = 0; i < PendingShotgunRequests.Num(); ++i)
 	{
-		for (auto& HitBoxPair : Frame.Character->HitCollisionBoxes)
+		const FShotgunServerSideRewindResult& Confirm = ShotgunShots[i].Result;
+		AWeapon* DamageCauser = PendingShotgunRequests[i].DamageCauser.Get();
+		if (Character == nullptr || DamageCauser == nullptr) continue;
+
+		for (int32 Victim = 0; Victim < Confirm.Victims.Num(); ++Victim)
 		{
-			if (HitBoxPair.Value != nullptr)
+			ABlasterCharacter* HitCharacter = Confirm.Victims[Victim];
+			if (!IsValid(HitCharacter)) continue;
+
+			int32 Hits = 0;
+			for (EHitbox HitType : { EHitbox::EH_Legs, EHitbox::EH_Body, EHitbox::EH_Head })
 			{
-				HitBoxPair.Value->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
-				HitBoxPair.Value->SetCollisionResponseToChannel(ECC_PlayerHitBox, ECollisionResponse::ECR_Block);
+				Hits += Confirm.GetHits(Victim, HitType);
 			}
+			if (Hits == 0) continue;
+
+			UGameplayStatics::ApplyDamage(
+				HitCharacter,
+				Hits * DamageCauser->GetDamage(),
+				Character->Controller,
+				DamageCauser,
+				UDamageType::StaticClass()
+			);
 		}
-		UBoxComponent* HeadBox = Frame.Character->HitCollisionBoxes[FName("head")];
-		HeadBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 	}
 
-	// check for body shots
-	for (auto& HitLocation : HitLocations)
+	// then projectiles, flat damage like AProjectileBullet::OnHit
+	for (int32 i = 0; i < PendingProjectileRequests.Num(); ++i)
 	{
-		FHitResult ConfirmHitResult;
-		const FVector TraceEnd = TraceStart + (HitLocation - TraceStart) * 1.25f;
-		if (World && Character && Character->GetEquippedWeapon())
+		const FServerSideRewindResultCapsule& Confirm = ProjectileShots[i].Result;
+		ABlasterCharacter* HitCharacter = PendingProjectileRequests[i].HitCharacter.Get();
+		AWeapon* DamageCauser = PendingProjectileRequests[i].DamageCauser.Get();
+		if (Character && IsValid(HitCharacter) && DamageCauser && Confirm.HitType != EHitbox::EH_None)
 		{
-			World->LineTraceSingleByChannel(
-				ConfirmHitResult,
-				TraceStart,
-				TraceStart + TraceEnd,
-				ECC_PlayerHitBox,
-				DamageCauserWeapon->GetTraceQueryParams()
+			UGameplayStatics::ApplyDamage(
+				HitCharacter,
+				DamageCauser->GetDamage(),
+				Character->Controller,
+				DamageCauser,
+				UDamageType::StaticClass()
 			);
-			ABlasterCharacter* BlasterCharacter = Cast<ABlasterCharacter>(ConfirmHitResult.GetActor());
-			if (BlasterCharacter)
-			{
-				if (ShotgunResult.BodyShots.Contains(BlasterCharacter))
-				{
-					ShotgunResult.BodyShots[BlasterCharacter]++;
-				}
-				else
-				{
-					ShotgunResult.BodyShots.Emplace(BlasterCharacter, 1);
-				}
-			}
+			HitCharacter->Multicast_SpawnBlood(Confirm.HitLocation, -Confirm.HitNormal, DamageCauser->GetWeaponType());
 		}
 	}
 
-	for (auto& Frame : CurrentFrames)
+	LagCompensationSubsystem->CountRewindBatches(PendingScoreRequests.Num(), Batches.Num());
+	INC_DWORD_STAT_BY(STAT_SSRScoreRequests, PendingScoreRequests.Num() + PendingShotgunRequests.Num() + PendingProjectileRequests.Num());
+	INC_DWORD_STAT_BY(STAT_SSRRewindBatches, Batches.Num());
+	// a hitscan request pays for every batch it was traced in, lookup included
+	for (const FRewindTest& Test : Tests)
 	{
-		ResetHitBoxes(Frame.Character, Frame);
-		EnableCharacterMeshCollision(Frame.Character, ECollisionEnabled::QueryAndPhysics);
+		RequestCycles[Test.Request] += Test.Cycles + Batches[Test.Batch].Cycles;
 	}
-	
-	return ShotgunResult;
-}
-
-void ULagCompensationComponent::CacheBoxPositions(ABlasterCharacter* HitCharacter, FFramePackage& OutFramePackage)
-{
-	if (HitCharacter == nullptr) return;
-	for (auto& HitBoxPair : HitCharacter->HitCollisionBoxes)
+	for (int32 i = 0; i < PendingScoreRequests.Num(); ++i)
 	{
-		if (HitBoxPair.Value != nullptr)
-		{
-			FBoxInformation BoxInfo;
-			BoxInfo.Location = HitBoxPair.Value->GetComponentLocation();
-			BoxInfo.Rotation = HitBoxPair.Value->GetComponentRotation();
-			BoxInfo.BoxExtent = HitBoxPair.Value->GetScaledBoxExtent();
-			OutFramePackage.HitBoxInfo.Add(HitBoxPair.Key, BoxInfo);
-		}
+		CountScoreRequest(Outcomes[i], Now - PendingScoreRequests[i].HitTime, RequestCycles[i]);
 	}
-}
-
-void ULagCompensationComponent::MoveBoxes(ABlasterCharacter* HitCharacter, const FFramePackage& Package)
-{
-	if (HitCharacter == nullptr) return;
-	for (auto& HitBoxPair : HitCharacter->HitCollisionBoxes)
+	for (int32 i = 0; i < PendingShotgunRequests.Num(); ++i)
 	{
-		if (HitBoxPair.Value != nullptr)
-		{
-			HitBoxPair.Value->SetWorldLocation(Package.HitBoxInfo[HitBoxPair.Key].Location);
-			HitBoxPair.Value->SetWorldRotation(Package.HitBoxInfo[HitBoxPair.Key].Rotation);
-			HitBoxPair.Value->SetBoxExtent(Package.HitBoxInfo[HitBoxPair.Key].BoxExtent);
-		}
+		CountScoreRequest(ShotgunShots[i].Outcome, Now - PendingShotgunRequests[i].HitTime, ShotgunShots[i].Cycles);
 	}
-}
-
-void ULagCompensationComponent::ResetHitBoxes(ABlasterCharacter* HitCharacter, const FFramePackage& Package)
-{
-	if (HitCharacter == nullptr) return;
-	for (auto& HitBoxPair : HitCharacter->HitCollisionBoxes)
+	for (int32 i = 0; i < PendingProjectileRequests.Num(); ++i)
 	{
-		if (HitBoxPair.Value != nullptr)
-		{
-			HitBoxPair.Value->SetWorldLocation(Package.HitBoxInfo[HitBoxPair.Key].Location);
-			HitBoxPair.Value->SetWorldRotation(Package.HitBoxInfo[HitBoxPair.Key].Rotation);
-			HitBoxPair.Value->SetBoxExtent(Package.HitBoxInfo[HitBoxPair.Key].BoxExtent);
-			HitBoxPair.Value->SetCollisionEnabled(ECollisionEnabled::NoCollision);
-		}
+		CountScoreRequest(ProjectileShots[i].Outcome, Now - PendingProjectileRequests[i].FireTime, ProjectileShots[i].Cycles);
 	}
-}
 
-void ULagCompensationComponent::EnableCharacterMeshCollision(ABlasterCharacter* HitCharacter, ECollisionEnabled::Type CollisionEnabled)
-{
-	if (HitCharacter && HitCharacter->GetMesh())
-	{
-		HitCharacter->GetMesh()->SetCollisionEnabled(CollisionEnabled);
-	}
+	PendingScoreRequests.Reset();
+	PendingShotgunRequests.Reset();
+	PendingProjectileRequests.Reset();
 }
 
-void ULagCompensationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void ULagCompensationComponent::ProjectileServerScoreRequest_Implementation(ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector_NetQuantize100& InitialVelocity, uint16 ShotSequence, float FireTime, AWeapon* DamageCauser)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	AProjectileWeapon* ProjectileWeapon = Cast<AProjectileWeapon>(DamageCauser);
+	if (HitCharacter == nullptr || ProjectileWeapon == nullptr || Character == nullptr || ProjectileWeapon != Character->GetEquippedWeapon()) return;
+	if (!IsValidTraceStart(TraceStart)) return;
+	const float Speed = ProjectileWeapon->GetServerSideRewindSpeed();
+	if (Speed <= 0.f || InitialVelocity.IsNearlyZero()) return;
+	// the fire event is normally here first, if not the shot is played along the launch direction
+	if (!AcceptScoredShot(ProjectileWeapon, FVector_NetQuantize(TraceStart + InitialVelocity), ShotSequence)) return;
+	if (!ConsumeRequestBudget(1)) return;
 
-	//SaveFramePackage();
-	SaveFramePackageCapsule();
+	// rewound in ProcessScoreRequests with the rest of this tick's requests
+	const float Now = GetWorld()->GetTimeSeconds();
+	const FVector LaunchVelocity = InitialVelocity.GetSafeNormal() * Speed;
+	PendingProjectileRequests.Add(FProjectileScoreRequest{ HitCharacter, TraceStart, LaunchVelocity, FMath::Clamp(FireTime, Now - MaxRecordTime, Now), ProjectileWeapon });
 }
 
-void ULagCompensationComponent::SaveFramePackage()
+void ULagCompensationComponent::ShotgunServerScoreRequest_Implementation(const FVector_NetQuantize& TraceStart, const FVector_NetQuantize& HitTarget, uint16 ShotSequence, float HitTime, AWeapon* DamageCauser)
 {
-	if (Character == nullptr || !Character->HasAuthority()) return;
-	if (FrameHistory.Num() <= 1)
-	{
-		FFramePackage ThisFrame;
-		SaveFramePackage(ThisFrame);
-		FrameHistory.AddHead(ThisFrame);
-	}
-	else
-	{
-		float HistoryLength = FrameHistory.GetHead()->GetValue().Time - FrameHistory.GetTail()->GetValue().Time;
-		while (HistoryLength > MaxRecordTime)
-		{
-			FrameHistory.RemoveNode(FrameHistory.GetTail());
-			HistoryLength = FrameHistory.GetHead()->GetValue().Time - FrameHistory.GetTail()->GetValue().Time;
-		}
-		FFramePackage ThisFrame;
-		SaveFramePackage(ThisFrame);
-		FrameHistory.AddHead(ThisFrame);
+	AShotgun* Shotgun = Cast<AShotgun>(DamageCauser);
+	if (Shotgun == nullptr || Character == nullptr || Shotgun != Character->GetEquippedWeapon()) return;
+	if (!IsValidTraceStart(TraceStart)) return;
+	if (!AcceptScoredShot(Shotgun, HitTarget, ShotSequence)) return;
+	if (!ConsumeRequestBudget(Shotgun->GetTracesPerShot())) return;
 
-		//ShowFramePackage(ThisFrame, FColor::Red);
-	}
-}
+	TArray<FVector_NetQuantize> HitLocations;
+	Shotgun->ShotgunTraceEndWithScatter(TraceStart, HitTarget, ShotSequence, HitLocations);
 
-void ULagCompensationComponent::SaveFramePackageCapsule()
-{
-	if (Character == nullptr || !Character->HasAuthority()) return;
-	if (FrameHistoryCapsule.Num() <= 1)
-	{
-		FFramePackageCapsule ThisFrame;
-		SaveFramePackageCapsule(ThisFrame);
-		FrameHistoryCapsule.AddHead(ThisFrame);
-	}
-	else
+	// rewound in ProcessScoreRequests with the rest of this tick's requests
+	FShotgunScoreRequest& Request = PendingShotgunRequests.AddDefaulted_GetRef();
+	Request.TraceStart = TraceStart;
+	Request.HitTime = HitTime;
+	Request.DamageCauser = Shotgun;
+	// pellets stop at static geometry, nobody behind a wall is rewound or hit
+	for (const FVector_NetQuantize& HitLocation : HitLocations)
 	{
-		float HistoryLength = FrameHistoryCapsule.GetHead()->GetValue().Time - FrameHistoryCapsule.GetTail()->GetValue().Time;
-		while (HistoryLength > MaxRecordTime)
-		{
-			FrameHistoryCapsule.RemoveNode(FrameHistoryCapsule.GetTail());
-			HistoryLength = FrameHistoryCapsule.GetHead()->GetValue().Time - FrameHistoryCapsule.GetTail()->GetValue().Time;
-		}
-		FFramePackageCapsule ThisFrame;
-		SaveFramePackageCapsule(ThisFrame);
-		FrameHistoryCapsule.AddHead(ThisFrame);
-		//ShowFramePackageCapsule(ThisFrame, FColor::Red);
+		Request.TraceEnds.Add(ClipToStaticGeometry(TraceStart, TraceStart + (HitLocation - TraceStart) * 1.25f));
 	}
 }
 
-void ULagCompensationComponent::SaveFramePackage(FFramePackage& Package)
+bool ULagCompensationComponent::IsValidTraceStart(const FVector& TraceStart) const
 {
-	Character = Character == nullptr ? Cast<ABlasterCharacter>(GetOwner()) : Character;
-	if (Character)
-	{
-		Package.Time = GetWorld()->GetTimeSeconds();
-		Package.Character = Character;
-		for (auto& BoxPair : Character->HitCollisionBoxes)
-		{
-			FBoxInformation BoxInformation;
-			BoxInformation.Location = BoxPair.Value->GetComponentLocation();
-			BoxInformation.Rotation = BoxPair.Value->GetComponentRotation();
-			BoxInformation.BoxExtent = BoxPair.Value->GetScaledBoxExtent();
-			Package.HitBoxInfo.Add(BoxPair.Key, BoxInformation);
-		}
-	}
+	if (Character == nullptr || LagCompensationSubsystem == nullptr) return false;
+
+	const FVector ShooterLocation = Character->GetActorLocation();
+	const double Offset = FVector::Dist(ShooterLocation, TraceStart);
+	if (Offset > MaxTraceStartOffset) return false;
+	return Offset < UE_KINDA_SMALL_NUMBER || LagCompensationSubsystem->GetStaticOcclusion(ShooterLocation, TraceStart) * Offset + OcclusionTolerance >= Offset;
 }
 
-void ULagCompensationComponent::SaveFramePackageCapsule(FFramePackageCapsule& Package)
+FVector ULagCompensationComponent::ClipToStaticGeometry(const FVector& TraceStart, const FVector& TraceEnd) const
 {
-	Character = Character == nullptr ? Cast<ABlasterCharacter>(GetOwner()) : Character;
-	if (Character == nullptr || Character->GetMesh() == nullptr || Character->GetMesh()->GetPhysicsAsset() == nullptr) return;
+	const FVector TraceDelta = TraceEnd - TraceStart;
+	const double TraceLength = TraceDelta.Size();
+	if (LagCompensationSubsystem == nullptr || TraceLength < UE_KINDA_SMALL_NUMBER) return TraceEnd;
 
-	Package.Time = GetWorld()->GetTimeSeconds();
-	Package.Character = Character;
+	const double ClearLength = LagCompensationSubsystem->GetStaticOcclusion(TraceStart, TraceEnd) * TraceLength + OcclusionTolerance;
+	return TraceStart + TraceDelta * FMath::Min(ClearLength / TraceLength, 1.0);
+}
+
+FServerSideRewindResultCapsule ULagCompensationComponent::ProjectileConfirmHit(int32 HitTrack, const FVector& TraceStart, const FVector& InitialVelocity, float FireTime, float Now, float GravityZ, bool& bOutRewound, ULagCompensationSubsystem* Capture) const
+{
+	// The arc as straight segments. Each segment is traced against the victim as it was while the projectile flew along it,
+	// no further than where the projectile can have got to by now.
+	bOutRewound = false;
+	if (LagCompensationSubsystem == nullptr) return FServerSideRewindResultCapsule();
+	const FRewindHistory& History = LagCompensationSubsystem->GetHistory();
+	if (!History.IsValidTrack(HitTrack)) return FServerSideRewindResultCapsule();
 
-	USkeletalMeshComponent* Mesh = Character->GetMesh();
+	const float TimeStep = 1.f / ProjectileSimFrequency;
+	const float MaxSimTime = FMath::Min(MaxRecordTime, Now - FireTime);
+	const int32 NumSteps = FMath::CeilToInt(MaxSimTime * ProjectileSimFrequency);
 
-	for (auto& SkeletalBodySetup : Mesh->GetPhysicsAsset()->SkeletalBodySetups)
+	// Several segments usually fall between the same two saved frames, the bracket only moves its time for those.
+	// Segments that miss both frames' bounds never lerp anything, the rest only lerp the groups they reach.
+	FCapsuleFrameBracket Bracket;
+	FVector SegmentStart = TraceStart;
+	for (int32 Step = 1; Step <= NumSteps; ++Step)
 	{
-		const FName& BName = SkeletalBodySetup->BoneName;
-		const FTransform& BoneWorldTransform = Mesh->GetBoneTransform(Mesh->GetBoneIndex(BName));
-		const EHitbox BoneHitboxType = HitboxTypes.Contains(BName) ? HitboxTypes[BName] : EHitbox::EH_None;
-		for (auto& Sphyl : SkeletalBodySetup->AggGeom.SphylElems)
-		{
-			const FTransform& LocTransform = Sphyl.GetTransform();
-			const FTransform WorldTransform = LocTransform * BoneWorldTransform;
-			const float Radius = Sphyl.GetScaledRadius(WorldTransform.GetScale3D());
-			const FVector CapsuleCenter = WorldTransform.GetLocation();
-			const float CapsuleLength = Sphyl.GetScaledHalfLength(WorldTransform.GetScale3D()) - Radius;
-			const FVector CapsuleAxis = WorldTransform.GetUnitAxis(EAxis::Z);
-			const FVector A = CapsuleCenter + CapsuleAxis * CapsuleLength;
-			const FVector B = CapsuleCenter - CapsuleAxis * CapsuleLength;
+		const float SimTime = Step * TimeStep;
+		const FVector SegmentEnd = TraceStart + InitialVelocity * SimTime + FVector(0.f, 0.f, 0.5f * GravityZ * SimTime * SimTime);
 
-			FCapsuleInformation CapsuleInformation;
-			CapsuleInformation.A = A;
-			CapsuleInformation.B = B;
-			CapsuleInformation.Radius = Radius;
-			CapsuleInformation.Length = CapsuleLength;
-			CapsuleInformation.HitboxType = BoneHitboxType;
-			Package.HitCapsulesInfo.Add(CapsuleInformation);
+		if (History.SeekFrames(HitTrack, FireTime + SimTime - 0.5f * TimeStep, Bracket))
+		{
+			bOutRewound = true;
+			const FHitInfo HitInfo = TraceAgainstCapsules(Bracket, SegmentStart, SegmentEnd, ProjectileRadius);
+			if (Capture)
+			{
+				Capture->CaptureRewind(Bracket, SegmentStart, SegmentEnd, ProjectileRadius, HitInfo.HitType, HitInfo.Location, HitInfo.Normal);
+			}
+			if (HitInfo.HitType != EHitbox::EH_None)
+			{
+				return FServerSideRewindResultCapsule{ HitInfo.HitType, HitInfo.Location, HitInfo.Normal };
+			}
 		}
+		SegmentStart = SegmentEnd;
 	}
+	return FServerSideRewindResultCapsule();
 }
 
 void ULagCompensationComponent::DrawCapsuleHitBox()
@@ -772,14 +666,6 @@ void ULagCompensationComponent::DrawCapsuleHitBox()
 		{
 			auto LocTransform = y.GetTransform();
 			auto WorldTransform = LocTransform * BoneWorldTransform;
-			/*
-			DrawDebugCapsule(
-				GetWorld(),
-				WorldTransform.GetLocation(),
-				y.Length / 2 + y.Radius,
-				y.Radius, WorldTransform.GetRotation(),
-				FColor::Red
-			);*/
 			const float Radius = y.GetScaledRadius(WorldTransform.GetScale3D());
 			const FVector CapsuleCenter = WorldTransform.GetLocation();
 			const float CapsuleLength = y.GetScaledHalfLength(WorldTransform.GetScale3D()) - Radius;
@@ -787,31 +673,17 @@ void ULagCompensationComponent::DrawCapsuleHitBox()
 			const FVector A = CapsuleCenter + CapsuleAxis * CapsuleLength;
 			const FVector B = CapsuleCenter - CapsuleAxis * CapsuleLength;
 			DrawDebugLine(GetWorld(), A, B, FColor::Green);
-
-			TArray<FSphereInfo> Spheres;
-			CapsuleToSpheres(FVector(A), FVector(B), Radius, CapsuleLength, Spheres);
-
-			for (auto Sphere : Spheres)
-			{
-				DrawDebugSphere(GetWorld(), FVector(Sphere.Center), Sphere.Radius, 12, FColor::White);
-			}
-
-			// check for bullet vector intersection for each capsule, saving closest intersection point
-
-			//DrawDebugSphere(GetWorld(), A, Radius, 12, FColor::White);
-			//DrawDebugSphere(GetWorld(), B, Radius, 12, FColor::White);
+			DrawDebugCapsule(GetWorld(), CapsuleCenter, CapsuleLength + Radius, Radius, WorldTransform.GetRotation(), FColor::White);
 		}
 	}
-	//UE_LOG(LogTemp, Warning, TEXT("Spheres: %d"), SphereCount);
-	//SphereCount = 0;
 }
 
 void ULagCompensationComponent::Test(const FVector& TraceStart, const FVector& TraceEnd, const ABlasterCharacter* HitCharacter)
 {
 	if (HitCharacter == nullptr || HitCharacter->GetMesh() == nullptr || HitCharacter->GetMesh()->GetPhysicsAsset() == nullptr) return;
 
-	uint8 HitSpheres = 0;
-	//EHitbox HitType = EHitbox::EH_None;
+	const FVector Dir = (TraceEnd - TraceStart).GetSafeNormal();
+	const float Length = (TraceEnd - TraceStart).Size();
 
 	for (auto& x : HitCharacter->GetMesh()->GetPhysicsAsset()->SkeletalBodySetups)
 	{
@@ -821,14 +693,6 @@ void ULagCompensationComponent::Test(const FVector& TraceStart, const FVector& T
 		{
 			auto LocTransform = y.GetTransform();
 			auto WorldTransform = LocTransform * BoneWorldTransform;
-			/*
-			DrawDebugCapsule(
-				GetWorld(),
-				WorldTransform.GetLocation(),
-				y.Length / 2 + y.Radius,
-				y.Radius, WorldTransform.GetRotation(),
-				FColor::Red
-			);*/
 			const float Radius = y.GetScaledRadius(WorldTransform.GetScale3D());
 			const FVector CapsuleCenter = WorldTransform.GetLocation();
 			const float CapsuleLength = y.GetScaledHalfLength(WorldTransform.GetScale3D()) - Radius;
@@ -837,114 +701,77 @@ void ULagCompensationComponent::Test(const FVector& TraceStart, const FVector& T
 			const FVector B = CapsuleCenter - CapsuleAxis * CapsuleLength;
 			DrawDebugLine(GetWorld(), A, B, FColor::Green);
 
-			TArray<FSphereInfo> Spheres;
-			CapsuleToSpheres(FVector(A), FVector(B), Radius, CapsuleLength, Spheres);
-			const FVector Dir = (TraceEnd - TraceStart).GetSafeNormal();
-			const float Length = (TraceEnd - TraceStart).Size();
-			for (auto& Sphere : Spheres)
+			double Distance;
+			if (FCapsuleTrace::SegmentCapsuleIntersection(TraceStart, Dir, Length, A, B, Radius, Distance))
 			{
-				if (LineSphereIntersection(TraceStart, Dir, Length, Sphere.Center, Sphere.Radius))
-				{
-					const FVector IntersectionPoint = FirstIntersectionPoint(TraceStart, TraceEnd, Sphere.Center, Sphere.Radius);
-					DrawDebugSphere(GetWorld(), FVector(Sphere.Center), Sphere.Radius, 20, FColor::White, true);
-					DrawDebugPoint(GetWorld(), IntersectionPoint, 4.f, FColor::Red, true);
-					
-					++HitSpheres;
-					if (HitSpheres > 1)
-					{
-
-						return;
-					}
-				}
+				DrawDebugCapsule(GetWorld(), CapsuleCenter, CapsuleLength + Radius, Radius, WorldTransform.GetRotation(), FColor::White, true);
+				DrawDebugPoint(GetWorld(), TraceStart + Dir * Distance, 4.f, FColor::Red, true);
 			}
 		}
 	}
 }
 
-void ULagCompensationComponent::CapsuleToSpheres(const FVector& A, const FVector& B, const float Radius, const float Length, TArray<FSphereInfo>& OutSpheres)
+FHitInfo ULagCompensationComponent::TraceAgainstCapsules(FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius)
 {
-	OutSpheres.Add(FSphereInfo{A, Radius});
-	OutSpheres.Add(FSphereInfo{ (A+B)*0.5f, Radius });
-	OutSpheres.Add(FSphereInfo{ B, Radius });
-}
+	if (!Bracket.IsValid()) return FHitInfo();
+	const FCapsuleLayout& Layout = *Bracket.Layout;
 
-inline bool ULagCompensationComponent::LineSphereIntersection(const FVector& Start, const FVector& Dir, float Length, const FVector& Origin, float Radius)
-{
-	const FVector	EO = Start - Origin;
-	const float		v = (Dir | (Origin - Start));
-	const float		disc = Radius * Radius - ((EO | EO) - v * v);
+	// the rewound body is somewhere inside the bounds of both frames, most misses stop here
+	const FVector TraceDelta = TraceEnd - TraceStart;
+	if (!FMath::LineBoxIntersection(Bracket.Bounds.ExpandBy(TraceRadius), TraceStart, TraceEnd, TraceDelta)) return FHitInfo();
+
+	FHitInfo HitInfo;
+	double HitDistance = TNumericLimits<double>::Max();
+	const FVector Dir = TraceDelta.GetSafeNormal();
+	const double Length = TraceDelta.Size();
 
-	if (disc >= 0)
+	for (int32 Group = 0; Group < Layout.NumGroups(); ++Group)
 	{
-		const float	Time = (v - FMath::Sqrt(disc)) / Length;
+		if (!FMath::LineBoxIntersection(Bracket.GetGroupBounds(Group).ExpandBy(TraceRadius), TraceStart, TraceEnd, TraceDelta)) continue;
 
-		if (Time >= 0 && Time <= 1)
-			return 1;
-		else
-			return 0;
-	}
-	else
-		return 0;
-}
+		// only now interpolate this group's capsules, if an earlier trace hasn't already
+		const int32 Base = Group * FCapsuleTrace::Width;
+		const float* Capsules = Bracket.GetGroup(Group);
 
-inline FVector const ULagCompensationComponent::FirstIntersectionPoint(const FVector& LineStart, const FVector& LineEnd, const FVector& Center, const float Radius)
-{
-	const FVector Disp = LineEnd - LineStart;
-	const FVector Dir = (LineEnd - LineStart).GetSafeNormal();
-	const FVector ClosestPoint = FMath::ClosestPointOnLine(LineStart, LineEnd, Center);
-	const float ClosestLength = (ClosestPoint - Center).Size();
-	const float IntersectionLength = FMath::Sqrt(Radius * Radius - ClosestLength * ClosestLength);
+		// a trace with a radius hits wherever its centre line hits the capsules grown by that radius
+		alignas(16) float Radii[FCapsuleTrace::Width];
+		for (int32 Lane = 0; Lane < FCapsuleTrace::Width; ++Lane)
+		{
+			Radii[Lane] = Layout.Radii[Base + Lane] + TraceRadius;
+		}
 
-	return ClosestPoint - Dir * IntersectionLength;
-}
+		FCapsuleIndices HitLanes;
+		FCapsuleTrace::OverlapCapsules(
+			Capsules,
+			Radii,
+			FMath::Min(FCapsuleTrace::Width, Layout.Num() - Base),
+			FCapsuleTrace::Width,
+			TraceStart,
+			TraceEnd,
+			HitLanes
+		);
 
-FHitInfo ULagCompensationComponent::TraceAgainstCapsules(const FFramePackageCapsule& Package, const ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector& TraceEnd)
-{
-	if (HitCharacter == nullptr || HitCharacter->GetMesh() == nullptr || HitCharacter->GetMesh()->GetPhysicsAsset() == nullptr) return FHitInfo();
-	
-	FHitInfo HitInfo;
-	uint8 HitSpheres = 0;
-	const FVector Dir = (TraceEnd - TraceStart).GetSafeNormal();
-	const float Length = (TraceEnd - TraceStart).Size();
+		for (const int32 Lane : HitLanes)
+		{
+			const int32 CapsuleIndex = Base + Lane;
+			const EHitbox HitboxType = Layout.HitboxTypes[CapsuleIndex];
 
-	for (auto& Capsule : Package.HitCapsulesInfo)
-	{
-		// convert capsule to spheres for optimized collision check
-		TArray<FSphereInfo> Spheres;
-		CapsuleToSpheres(Capsule.A, Capsule.B, Capsule.Radius, Capsule.Length, Spheres);
+			// highest hitbox type wins, closest hit breaks ties
+			if (HitboxType < HitInfo.HitType) continue;
 
-		for (auto& Sphere : Spheres)
-		{
-			//const bool bTraceIntersectsSphere = FMath::LineSphereIntersection(FVector3f(TraceStart), FVector3f(Dir), Length, FVector3f(Sphere.Center), Sphere.Radius);
-			const bool bTraceIntersectsSphere = LineSphereIntersection(TraceStart, Dir, Length, Sphere.Center, Sphere.Radius);
-			// check if weapon trace intersects with each sphere of this capsule
-			if (bTraceIntersectsSphere)
+			const FVector A(Capsules[Lane], Capsules[FCapsuleTrace::Width + Lane], Capsules[2 * FCapsuleTrace::Width + Lane]);
+			const FVector B(Capsules[3 * FCapsuleTrace::Width + Lane], Capsules[4 * FCapsuleTrace::Width + Lane], Capsules[5 * FCapsuleTrace::Width + Lane]);
+			double Distance;
+			if (!FCapsuleTrace::SegmentCapsuleIntersection(TraceStart, Dir, Length, A, B, Radii[Lane], Distance)) continue;
+
+			if (HitInfo.HitType < HitboxType || Distance < HitDistance)
 			{
-				++HitSpheres;
-				const FVector IntersectionPoint = FirstIntersectionPoint(TraceStart, TraceEnd, Sphere.Center, Sphere.Radius);
-				if (HitInfo.HitType < Capsule.HitboxType)
-				{
-					HitInfo.Location = IntersectionPoint;
-					HitInfo.HitType = Capsule.HitboxType;
-					HitInfo.Normal = (HitInfo.Location - Sphere.Center) / Sphere.Radius;
-				}
-				else if (HitInfo.HitType == Capsule.HitboxType)
-				{
-					const float Dist1 = FVector::DistSquared(HitInfo.Location, TraceStart);
-					const float Dist2 = FVector::DistSquared(IntersectionPoint, TraceStart);
-					if (Dist1 > Dist2)
-					{
-						HitInfo.Location = IntersectionPoint;
-						HitInfo.HitType = Capsule.HitboxType;
-						HitInfo.Normal = (HitInfo.Location - Sphere.Center) / Sphere.Radius;
-					}
-				}
-				if (HitSpheres >= MaxSpheresHit)
-				{
-					return HitInfo;
-				}
+				HitDistance = Distance;
+				HitInfo.HitType = HitboxType;
+				HitInfo.Location = TraceStart + Dir * Distance;
+				HitInfo.Normal = FCapsuleTrace::CapsuleNormal(HitInfo.Location, A, B);
 			}
 		}
 	}
 	return HitInfo;
-}
\ No newline at end of file
+}
@@ -5,22 +5,10 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "Blaster/BlasterTypes/Hitbox.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
 #include "LagCompensationComponent.generated.h"
 
-USTRUCT(BlueprintType)
-struct FBoxInformation
-{
-	GENERATED_BODY()
-
-	UPROPERTY()
-	FVector Location;
-
-	UPROPERTY()
-	FRotator Rotation;
-
-	UPROPERTY()
-	FVector BoxExtent;
-};
+struct FRewindVictim;
 
 USTRUCT(BlueprintType)
 struct FCapsuleInformation
@@ -43,15 +31,6 @@ struct FCapsuleInformation
 	EHitbox HitboxType = EHitbox::EH_None;
 };
 
-USTRUCT(BlueprintType)
-struct FSphereInfo
-{
-	GENERATED_BODY()
-
-	FVector Center;
-	float Radius;
-};
-
 // info for the weapon fire trace hit
 USTRUCT(BlueprintType)
 struct FHitInfo
@@ -71,45 +50,66 @@ struct FHitInfo
 };
 
 USTRUCT(BlueprintType)
-struct FFramePackage
+struct FFramePackageCapsule
 {
 	GENERATED_BODY()
 
 	UPROPERTY()
 	float Time;
 
+	// Capsule end points stored structure-of-arrays: all A.X, then all A.Y, A.Z, B.X, B.Y, B.Z.
+	// Each component array is Layout->Stride long, the padding is zero.
 	UPROPERTY()
-	TMap<FName, FBoxInformation> HitBoxInfo;
+	TArray<float> Positions;
+
+	FCapsuleLayoutPtr Layout;
 
 	UPROPERTY()
 	ABlasterCharacter* Character;
+
+	FORCEINLINE int32 NumCapsules() const { return Layout ? Layout->Num() : 0; }
+	FORCEINLINE int32 Stride() const { return Layout ? Layout->Stride : 0; }
+	FORCEINLINE FVector GetA(int32 Index) const
+	{
+		const int32 S = Stride();
+		return FVector(Positions[Index], Positions[S + Index], Positions[2 * S + Index]);
+	}
+	FORCEINLINE FVector GetB(int32 Index) const
+	{
+		const int32 S = Stride();
+		return FVector(Positions[3 * S + Index], Positions[4 * S + Index], Positions[5 * S + Index]);
+	}
+	FCapsuleInformation GetCapsule(int32 Index) const;
 };
 
-USTRUCT(BlueprintType)
-struct FFramePackageCapsule
+// A hitscan score request waiting for the next tick, see ULagCompensationComponent::ProcessScoreRequests
+struct FCapsuleScoreRequest
 {
-	GENERATED_BODY()
-
-	UPROPERTY()
-	float Time;
-
-	UPROPERTY()
-	TArray<FCapsuleInformation> HitCapsulesInfo;
-
-	UPROPERTY()
-	ABlasterCharacter* Character;
+	FVector_NetQuantize TraceStart;
+	FVector_NetQuantize HitLocation;
+	float HitTime = 0.f;
+	TWeakObjectPtr<class AWeapon> DamageCauser;
+	// HitLocation is the scattered trace end, not the point the client hit
+	bool bScattered = false;
 };
 
-USTRUCT(BlueprintType)
-struct FServerSideRewindResult
+// A shotgun score request waiting for the next tick, its pellets already regenerated by the server
+struct FShotgunScoreRequest
 {
-	GENERATED_BODY()
-
-	UPROPERTY()
-	bool bHitConfirmed;
+	FVector TraceStart = FVector::ZeroVector;
+	TArray<FVector, TInlineAllocator<16>> TraceEnds;
+	float HitTime = 0.f;
+	TWeakObjectPtr<AWeapon> DamageCauser;
+};
 
-	UPROPERTY()
-	bool bHeadShot;
+// A projectile score request waiting for the next tick
+struct FProjectileScoreRequest
+{
+	TWeakObjectPtr<class ABlasterCharacter> HitCharacter;
+	FVector_NetQuantize TraceStart;
+	FVector_NetQuantize100 InitialVelocity;
+	float FireTime = 0.f;
+	TWeakObjectPtr<AWeapon> DamageCauser;
 };
 
 USTRUCT(BlueprintType)
@@ -132,10 +132,16 @@ struct FShotgunServerSideRewindResult
 {
 	GENERATED_BODY()
 
+	static constexpr int32 NumHitboxTypes = static_cast<int32>(EHitbox::EH_MAX);
+
 	UPROPERTY()
-	TMap<ABlasterCharacter*, uint32> HeadShots;
+	TArray<ABlasterCharacter*> Victims;
+
+	// pellets that hit each victim, NumHitboxTypes counts per victim indexed by EHitbox
 	UPROPERTY()
-	TMap<ABlasterCharacter*, uint32> BodyShots;
+	TArray<int32> HitCounts;
+
+	FORCEINLINE int32 GetHits(int32 Victim, EHitbox HitType) const { return HitCounts[Victim * NumHitboxTypes + static_cast<int32>(HitType)]; }
 };
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -146,130 +152,88 @@ class BLASTER_API ULagCompensationComponent : public UActorComponent
 public:	
 	ULagCompensationComponent();
 	friend class ABlasterCharacter;
+	friend class ULagCompensationSubsystem;
 
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
-	void ShowFramePackage(const FFramePackage& Package, const FColor& Color);
 	void ShowFramePackageCapsule(const FFramePackageCapsule& Package, const FColor& Color);
 
-	/**
-	* Hitscan
-	*/
-	FServerSideRewindResult ServerSideRewind(class ABlasterCharacter* HitCharacter, 
-		const FVector_NetQuantize& TraceStart, 
-		const FVector_NetQuantize& HitLocation, 
-		float HitTime);
-
-	FServerSideRewindResultCapsule ServerSideRewindCapsule(
-		ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize& HitLocation,
-		float HitTime
-	);
-
-	/**
-	* Projectile
-	*/
-	FServerSideRewindResult ProjectileServerSideRewind(ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize100& InitialVelocity,
-		float HitTime);
-
-	/**
-	* Shotgun
-	*/
-	FShotgunServerSideRewindResult ShotgunServerSideRewind(
-		const TArray<ABlasterCharacter*>& HitCharacters,
-		const FVector_NetQuantize& TraceStart,
-		const TArray<FVector_NetQuantize>& HitLocations,
-		float HitTime);
-
-	UFUNCTION(Server, Reliable)
-	void ServerScoreRequest(
-		ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize& HitLocation,
-		float HitTime,
-		class AWeapon* DamageCauser
+	// Highest hitbox type the trace touches in the rewound capsules, nearest first among equals.
+	// TraceRadius > 0 makes it a sphere sweep
+	static FHitInfo TraceAgainstCapsules(FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius = 0.f);
+
+	// Traces every pellet against every victim, each pellet counts against the nearest victim it touches.
+	// Only reads the victims' saved frames. Returns whether any pellet hit. Each trace is recorded into Capture if it is set,
+	// which isn't thread safe.
+	static bool ConfirmShotgunPellets(
+		TArrayView<FRewindVictim> Victims,
+		const FVector& TraceStart,
+		TArrayView<const FVector> TraceEnds,
+		FShotgunServerSideRewindResult& OutResult,
+		class ULagCompensationSubsystem* Capture = nullptr
 	);
 
+	// The server works out who was hit from the rewound trace, the client's hit only decides whether to send this.
+	// HitTarget is unscattered, the server draws the scatter of ShotSequence from its own weapon
 	UFUNCTION(Server, Reliable)
 	void ServerScoreRequestCapsule(
-		ABlasterCharacter* HitCharacter,
 		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize& HitLocation,
+		const FVector_NetQuantize& HitTarget,
+		uint16 ShotSequence,
 		float HitTime,
 		class AWeapon* DamageCauser
 	);
 
+	// Only the launch direction of InitialVelocity is the client's, the speed is the server's projectile class's.
+	// FireTime is clamped to the saved history
 	UFUNCTION(Server, Reliable)
 	void ProjectileServerScoreRequest(
 		ABlasterCharacter* HitCharacter,
 		const FVector_NetQuantize& TraceStart,
 		const FVector_NetQuantize100& InitialVelocity,
-		float HitTime
+		uint16 ShotSequence,
+		float FireTime,
+		AWeapon* DamageCauser
 	);
 
+	// The server regenerates the pellets of shot ShotSequence with its own shotgun's spread, a client can't choose where they go
 	UFUNCTION(Server, Reliable)
 	void ShotgunServerScoreRequest(
-		const TArray<ABlasterCharacter*>& HitCharacters,
 		const FVector_NetQuantize& TraceStart,
-		const TArray<FVector_NetQuantize>& HitLocations,
+		const FVector_NetQuantize& HitTarget,
+		uint16 ShotSequence,
 		float HitTime,
 		AWeapon* DamageCauser
 	);
 
 protected:
 	virtual void BeginPlay() override;	
-	void SaveFramePackage(FFramePackage& Package);
-	void SaveFramePackageCapsule(FFramePackageCapsule& Package);
-	FFramePackage InterpBetweenFrames(const FFramePackage& OlderFrame, const FFramePackage& YoungerFrame, float HitTime);
-	FFramePackageCapsule InterpBetweenFramesCapsule(const FFramePackageCapsule& OlderFrame, const FFramePackageCapsule& YoungerFrame, float HitTime);
-	void CacheBoxPositions(ABlasterCharacter* HitCharacter, FFramePackage& OutFramePackage);
-	void MoveBoxes(ABlasterCharacter* HitCharacter, const FFramePackage& Package);
-	void ResetHitBoxes(ABlasterCharacter* HitCharacter, const FFramePackage& Package);
-	void EnableCharacterMeshCollision(ABlasterCharacter* HitCharacter, ECollisionEnabled::Type CollisionEnabled);
-	void SaveFramePackage();
-	void SaveFramePackageCapsule();
-	FFramePackage GetFrameToCheck(ABlasterCharacter* HitCharacter, float HitTime);
-	FFramePackageCapsule GetFrameToCheckCapsule(ABlasterCharacter* HitCharacter, float HitTime);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// Frames are recorded no closer together than this, so the history can't hold more than GetHistoryCapacity of them
+	float GetMinRecordInterval() const;
+	int32 GetHistoryCapacity() const;
+	bool GetFrameBracketCapsule(ABlasterCharacter* HitCharacter, float HitTime, FCapsuleFrameBracket& OutBracket);
 
-	/**
-	* Hitscan
-	*/
-	FServerSideRewindResult ConfirmHit(
-		const FFramePackage& Package,
-		ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize& HitLocation
-	);
-
-	FServerSideRewindResultCapsule ConfirmHitCapsule(
-		const FFramePackageCapsule& Package,
-		ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize& HitLocation
-	);
+	// Rewinds every queued score request: hitscan traces against the characters they reach, once per victim and HitTime group,
+	// shotgun pellets against every character they reach and projectiles along their arc, all in one ParallelFor.
+	// Then applies damage on the game thread in arrival order
+	void ProcessScoreRequests();
 
 	/**
 	* Projectile
 	*/
-	FServerSideRewindResult ProjectileConfirmHit(
-		const FFramePackage& Package,
-		ABlasterCharacter* HitCharacter,
-		const FVector_NetQuantize& TraceStart,
-		const FVector_NetQuantize100& InitialVelocity,
-		float HitTime
-	);
-
-	/**
-	* Shotgun
-	*/
-
-	FShotgunServerSideRewindResult ShotgunConfirmHit(
-		const TArray<FFramePackage>& FramePackages,
-		const FVector_NetQuantize& TraceStart,
-		const TArray<FVector_NetQuantize>& HitLocations
-		);
+	// Traces the projectile's arc against the capsules of history track HitTrack, each segment rewound to when the projectile was on it.
+	// Only reads saved frames, never the victim or the physics scene, so it can run off the game thread.
+	// bOutRewound is false if no segment had saved frames to trace against.
+	// Each traced segment is recorded into Capture if it is set, which isn't thread safe.
+	FServerSideRewindResultCapsule ProjectileConfirmHit(
+		int32 HitTrack,
+		const FVector& TraceStart,
+		const FVector& InitialVelocity,
+		float FireTime,
+		float Now,
+		float GravityZ,
+		bool& bOutRewound,
+		class ULagCompensationSubsystem* Capture = nullptr
+	) const;
 
 private:
 
@@ -279,34 +243,72 @@ private:
 	UPROPERTY()
 	class ABlasterPlayerController* Controller;
 
-	TDoubleLinkedList<FFramePackage> FrameHistory;
-	TDoubleLinkedList<FFramePackageCapsule> FrameHistoryCapsule;
+	UPROPERTY()
+	class ULagCompensationSubsystem* LagCompensationSubsystem;
+
+	// This character's capsule history in the subsystem's FRewindHistory
+	int32 RewindTrack = INDEX_NONE;
 
 	UPROPERTY(EditAnywhere)
 	float MaxRecordTime = 2.f;
 
-	UPROPERTY()
-	AWeapon* DamageCauserWeapon;
+	// Used to pace the frame history when there is no net driver to read NetServerMaxTickRate from
+	UPROPERTY(EditAnywhere)
+	float DefaultServerTickRate = 120.f;
 
-	void DrawCapsuleHitBox();
+	// Score requests received since the last tick
+	TArray<FCapsuleScoreRequest> PendingScoreRequests;
+	TArray<FShotgunScoreRequest> PendingShotgunRequests;
+	TArray<FProjectileScoreRequest> PendingProjectileRequests;
 
-	void Test(const FVector& TraceStart, const FVector& TraceEnd, const ABlasterCharacter* HitCharacter);
+	// Queued requests against the same victim with HitTimes this close share one rewound frame
+	UPROPERTY(EditAnywhere)
+	float RewindBatchTimeTolerance = 0.004f;
+
+	// Fewer rewinds than this, counting hitscan batches, shotgun shots and projectiles, run on the game thread, not worth the task overhead
+	UPROPERTY(EditAnywhere)
+	int32 ParallelRewindMinBatches = 2;
 
-	void CapsuleToSpheres(const FVector& A, const FVector& B, const float Radius, const float Length, TArray<FSphereInfo>& OutSpheres);
+	// Seconds of the equipped weapon's fastest fire a client may send score requests for at once,
+	// absorbs requests bunched up by the network
+	UPROPERTY(EditAnywhere)
+	float ScoreRequestBurst = 1.f;
 
-	int SphereCount = 0;
+	// Charges a score request of Traces rewound traces to the owning client's budget, false if it should be dropped
+	bool ConsumeRequestBudget(int32 Traces);
 
-	// copied from Vector.h to avoid having to cast FVector to FVector3f every time we call this
-	inline bool LineSphereIntersection(const FVector& Start, const FVector& Dir, float Length, const FVector& Origin, float Radius);
+	// False unless shot ShotSequence of Weapon is one the server accepted and it hasn't been scored yet. A score request
+	// can arrive before the fire event batch carrying its shot, so the shot is accepted here first if need be
+	bool AcceptScoredShot(AWeapon* Weapon, const FVector_NetQuantize& HitTarget, uint16 ShotSequence);
 
-	// Returns first intersection point from a line intersecting with a sphere. Assumes that the line does intersect with the sphere.
-	inline FVector const FirstIntersectionPoint(const FVector& LineStart, const FVector& LineEnd, const FVector& Center, const float Radius);
+	// cm a rewound hit may lie past static geometry and still count, covers the client's and the server's
+	// slightly different trace starts
+	UPROPERTY(EditAnywhere)
+	float OcclusionTolerance = 5.f;
 
-	FHitInfo TraceAgainstCapsules(const FFramePackageCapsule& Package, const ABlasterCharacter* HitCharacter, const FVector_NetQuantize& TraceStart, const FVector& TraceEnd);
+	// TraceEnd pulled back to OcclusionTolerance past the first static geometry the trace meets
+	FVector ClipToStaticGeometry(const FVector& TraceStart, const FVector& TraceEnd) const;
 
-	// Maximum number of hits to check in TraceAgainstCapsules
-	UPROPERTY(EditDefaultsOnly)
-	uint8 MaxSpheresHit = 4;
+	// cm a score request's TraceStart may be from the shooter, the muzzle's offset plus how far the shooter
+	// can have moved while the request was on its way
+	UPROPERTY(EditAnywhere)
+	float MaxTraceStartOffset = 200.f;
+
+	// Every wall check of a score request starts at its TraceStart, so it has to be the shooter's muzzle:
+	// false if it's further than MaxTraceStartOffset from the shooter or behind static geometry from them
+	bool IsValidTraceStart(const FVector& TraceStart) const;
+
+	// Samples per second of the projectile arc traced by ProjectileConfirmHit. Each segment rewinds the victim to
+	// its midpoint, so this also bounds how far off in time the victim can be: half a step
+	UPROPERTY(EditAnywhere)
+	float ProjectileSimFrequency = 60.f;
+
+	UPROPERTY(EditAnywhere)
+	float ProjectileRadius = 5.f;
+
+	void DrawCapsuleHitBox();
+
+	void Test(const FVector& TraceStart, const FVector& TraceEnd, const ABlasterCharacter* HitCharacter);
 
 public:
 
@@ -0,0 +1,410 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LagCompensationSubsystem.h"
+#include "Blaster/Blaster.h"
+#include "Blaster/BlasterComponents/LagCompensationComponent.h"
+#include "Blaster/Character/BlasterCharacter.h"
+#include "PhysicsEngine/PhysicsAsset.h"
+#include "Engine/SkinnedAsset.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimMontage.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/AnyOf.h"
+#include "Engine/NetConnection.h"
+#include "Misc/Paths.h"
+
+DECLARE_CYCLE_STAT(TEXT("Record Frames"), STAT_SSRRecordFrames, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Broadphase Tracks"), STAT_SSRBroadphaseTracks, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occlusion Traces"), STAT_SSROcclusionTraces, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occlusion Cache Hits"), STAT_SSROcclusionCacheHits, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rate Limited Requests"), STAT_SSRRateLimitedRequests, STATGROUP_BlasterSSR);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Budgeted Connections"), STAT_SSRBudgetedConnections, STATGROUP_BlasterSSR);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Requests Per Batch"), STAT_SSRRequestsPerBatch, STATGROUP_BlasterSSR);
+
+static TAutoConsoleVariable<float> CVarRecordTolerance(
+	TEXT("Blaster.SSR.RecordTolerance"),
+	0.5f,
+	TEXT("Capsule end points moving less than this many cm since the last stored frame don't store a new one.\n")
+	TEXT("Rewinds stay within twice this of the recorded pose. 0 stores every frame."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<FString> CVarCaptureRewinds(
+	TEXT("Blaster.SSR.CaptureRewinds"),
+	TEXT(""),
+	TEXT("File the server records its rewinds to for Blaster.SSR.ReplayCapture, written when this changes or the world ends.\n")
+	TEXT("Relative to the project's Saved directory. Empty doesn't record."),
+	ECVF_Default
+);
+
+// root movement in one tick that can only be a teleport, always starts a new frame
+static constexpr float TeleportDistance = 100.f;
+
+void ULagCompensationSubsystem::Deinitialize()
+{
+	SaveCapture();
+	Super::Deinitialize();
+}
+
+void ULagCompensationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UWorld* World = GetWorld();
+	if (World == nullptr || World->GetNetMode() == NM_Client) return;
+
+	OcclusionCache.Reset();
+	UpdateCapture();
+
+	// budgets of closed connections
+	for (auto It = ScoreRequestBudgets.CreateIterator(); It; ++It)
+	{
+		if (!It->Key.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	SET_DWORD_STAT(STAT_SSRBudgetedConnections, ScoreRequestBudgets.Num());
+
+	// rewind against the history recorded up to last tick, the same history the clients saw when they fired.
+	// Copied since applying damage can end up unregistering characters.
+	TArray<TWeakObjectPtr<ULagCompensationComponent>, TInlineAllocator<32>> Shooters;
+	for (const FRecordedCharacter& Recorded : RecordedCharacters)
+	{
+		Shooters.Add(Recorded.LagCompensation);
+	}
+	TickScoreRequests = 0;
+	TickRewindBatches = 0;
+	for (const TWeakObjectPtr<ULagCompensationComponent>& Shooter : Shooters)
+	{
+		if (ULagCompensationComponent* LagCompensation = Shooter.Get())
+		{
+			LagCompensation->ProcessScoreRequests();
+		}
+	}
+	SET_FLOAT_STAT(STAT_SSRRequestsPerBatch, TickRewindBatches > 0 ? float(TickScoreRequests) / TickRewindBatches : 0.f);
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(SSR_Record);
+	SCOPE_CYCLE_COUNTER(STAT_SSRRecordFrames);
+	const float Time = World->GetTimeSeconds();
+	for (FRecordedCharacter& Recorded : RecordedCharacters)
+	{
+		RecordFrame(Recorded, Time);
+	}
+}
+
+TStatId ULagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULagCompensationSubsystem, STATGROUP_BlasterSSR);
+}
+
+bool ULagCompensationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void ULagCompensationSubsystem::Register(ULagCompensationComponent* LagCompensation)
+{
+	if (LagCompensation == nullptr || LagCompensation->Character == nullptr) return;
+	if (RecordedCharacters.ContainsByPredicate([LagCompensation](const FRecordedCharacter& Recorded) { return Recorded.LagCompensation == LagCompensation; })) return;
+
+	// the track is created on the first recorded frame, once the mesh has its physics asset and pose
+	FRecordedCharacter& Recorded = RecordedCharacters.AddDefaulted_GetRef();
+	Recorded.LagCompensation = LagCompensation;
+	Recorded.Character = LagCompensation->Character;
+}
+
+void ULagCompensationSubsystem::Unregister(ULagCompensationComponent* LagCompensation)
+{
+	const int32 Index = RecordedCharacters.IndexOfByPredicate([LagCompensation](const FRecordedCharacter& Recorded) { return Recorded.LagCompensation == LagCompensation; });
+	if (Index == INDEX_NONE) return;
+
+	RemoveTrack(RecordedCharacters[Index]);
+	if (LagCompensation)
+	{
+		LagCompensation->RewindTrack = INDEX_NONE;
+	}
+	RecordedCharacters.RemoveAtSwap(Index);
+}
+
+bool ULagCompensationSubsystem::GetFrameBracket(const ABlasterCharacter* HitCharacter, float HitTime, FCapsuleFrameBracket& OutBracket) const
+{
+	if (HitCharacter == nullptr || HitCharacter->GetLagCompensation() == nullptr) return false;
+	return History.FindFrames(HitCharacter->GetLagCompensation()->RewindTrack, HitTime, OutBracket);
+}
+
+void ULagCompensationSubsystem::UpdateCapture()
+{
+	FString NewPath = CVarCaptureRewinds.GetValueOnGameThread();
+	if (!NewPath.IsEmpty() && FPaths::IsRelative(NewPath))
+	{
+		NewPath = FPaths::Combine(FPaths::ProjectSavedDir(), NewPath);
+	}
+	if (NewPath == CapturePath) return;
+
+	SaveCapture();
+	CapturePath = NewPath;
+}
+
+void ULagCompensationSubsystem::SaveCapture()
+{
+	if (!CapturePath.IsEmpty())
+	{
+		if (Capture.Save(CapturePath))
+		{
+			UE_LOG(LogTemp, Display, TEXT("Saved %d rewinds to %s"), Capture.Num(), *CapturePath);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't save rewinds to %s"), *CapturePath);
+		}
+	}
+	Capture.Reset();
+}
+
+void ULagCompensationSubsystem::CaptureRewind(const FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius, EHitbox HitType, const FVector& HitLocation, const FVector& HitNormal)
+{
+	if (!IsCapturingRewinds()) return;
+	Capture.Add(Bracket, TraceStart, TraceEnd, TraceRadius, HitType, HitLocation, HitNormal);
+}
+
+bool ULagCompensationSubsystem::ConsumeScoreRequestBudget(const AActor* Requester, float Cost, float Rate, float Burst)
+{
+	UNetConnection* Connection = Requester ? Requester->GetNetConnection() : nullptr;
+	if (Connection == nullptr) return true;
+
+	// always room for at least one request, however slow the weapon
+	const float Capacity = FMath::Max(Rate * Burst, Cost);
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	FScoreRequestBudget* Budget = ScoreRequestBudgets.Find(Connection);
+	if (Budget == nullptr)
+	{
+		Budget = &ScoreRequestBudgets.Add(Connection);
+		Budget->Tokens = Capacity;
+		Budget->LastRefillTime = Now;
+	}
+	Budget->Tokens = FMath::Min(Capacity, Budget->Tokens + float(Now - Budget->LastRefillTime) * Rate);
+	Budget->LastRefillTime = Now;
+
+	if (Budget->Tokens < Cost)
+	{
+		++Budget->Dropped;
+		INC_DWORD_STAT(STAT_SSRRateLimitedRequests);
+		UE_LOG(LogTemp, Verbose, TEXT("Dropped score request from %s, %u dropped and %u accepted so far"), *GetNameSafe(Requester), Budget->Dropped, Budget->Accepted);
+		return false;
+	}
+	Budget->Tokens -= Cost;
+	++Budget->Accepted;
+	return true;
+}
+
+float ULagCompensationSubsystem::GetStaticOcclusion(const FVector& TraceStart, const FVector& TraceEnd)
+{
+	auto GridCell = [](const FVector& Location)
+		{
+			return FIntVector(
+				FMath::RoundToInt(Location.X / OcclusionCacheGrid),
+				FMath::RoundToInt(Location.Y / OcclusionCacheGrid),
+				FMath::RoundToInt(Location.Z / OcclusionCacheGrid)
+			);
+		};
+	const FOcclusionKey Key(GridCell(TraceStart), GridCell(TraceEnd));
+	if (const float* Cached = OcclusionCache.Find(Key))
+	{
+		INC_DWORD_STAT(STAT_SSROcclusionCacheHits);
+		return *Cached;
+	}
+
+	INC_DWORD_STAT(STAT_SSROcclusionTraces);
+	float Clear = 1.f;
+	FHitResult Hit;
+	if (GetWorld()->LineTraceSingleByObjectType(Hit, TraceStart, TraceEnd, FCollisionObjectQueryParams(ECC_WorldStatic)))
+	{
+		Clear = Hit.Time;
+	}
+	OcclusionCache.Add(Key, Clear);
+	return Clear;
+}
+
+FCapsuleLayoutPtr ULagCompensationSubsystem::GetCapsuleLayout(USkeletalMeshComponent* Mesh)
+{
+	UPhysicsAsset* PhysicsAsset = Mesh->GetPhysicsAsset();
+	const FLayoutKey Key(PhysicsAsset, Mesh->GetSkinnedAsset());
+	if (const FCapsuleLayoutPtr* Cached = LayoutCache.Find(Key))
+	{
+		return *Cached;
+	}
+
+	// drop layouts of unloaded assets, tracks still using them keep their own reference
+	for (auto It = LayoutCache.CreateIterator(); It; ++It)
+	{
+		if (!It->Key.Key.IsValid() || !It->Key.Value.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// Radii and lengths are taken at the physics asset's own scale, characters are never scaled
+	TSharedRef<FCapsuleLayout, ESPMode::ThreadSafe> Layout = MakeShared<FCapsuleLayout, ESPMode::ThreadSafe>();
+	for (auto& SkeletalBodySetup : PhysicsAsset->SkeletalBodySetups)
+	{
+		const FName& BName = SkeletalBodySetup->BoneName;
+		const int32 BoneIndex = Mesh->GetBoneIndex(BName);
+		if (BoneIndex == INDEX_NONE) continue;
+
+		const EHitbox BoneHitboxType = HitboxTypes.Contains(BName) ? HitboxTypes[BName] : EHitbox::EH_None;
+		for (auto& Sphyl : SkeletalBodySetup->AggGeom.SphylElems)
+		{
+			Layout->AddSphyl(Sphyl, BoneIndex, BoneHitboxType);
+		}
+	}
+	Layout->Finalize();
+
+	LayoutCache.Add(Key, Layout);
+	return Layout;
+}
+
+int32 ULagCompensationSubsystem::FindRewindCandidates(const FVector& TraceStart, const FVector& TraceEnd, float HitTime, const ABlasterCharacter* IgnoreCharacter, TArray<FRewindCandidate, TInlineAllocator<8>>& OutCandidates) const
+{
+	OutCandidates.Reset();
+	int32 Unrewound = 0;
+
+	FRewindTrackIds Tracks;
+	Broadphase.QuerySegment(TraceStart, TraceEnd, Tracks);
+	INC_DWORD_STAT_BY(STAT_SSRBroadphaseTracks, Tracks.Num());
+
+	for (int32 Track : Tracks)
+	{
+		ABlasterCharacter* Character = TrackCharacters[Track].Get();
+		if (Character == nullptr || Character == IgnoreCharacter) continue;
+
+		FCapsuleFrameBracket Bracket;
+		if (!History.FindFrames(Track, HitTime, Bracket))
+		{
+			++Unrewound;
+			continue;
+		}
+
+		FVector HitLocation, HitNormal;
+		float HitFraction;
+		if (!FMath::LineExtentBoxIntersection(Bracket.Bounds, TraceStart, TraceEnd, FVector::ZeroVector, HitLocation, HitNormal, HitFraction)) continue;
+		OutCandidates.Add(FRewindCandidate{ Character, HitFraction * (TraceEnd - TraceStart).Size() });
+	}
+
+	OutCandidates.Sort([](const FRewindCandidate& A, const FRewindCandidate& B) { return A.Distance < B.Distance; });
+	return Unrewound;
+}
+
+int32 ULagCompensationSubsystem::FindRewindVictims(const FVector& TraceStart, TArrayView<const FVector> TraceEnds, float HitTime, const ABlasterCharacter* IgnoreCharacter, TArray<FRewindVictim, TInlineAllocator<4>>& OutVictims) const
+{
+	OutVictims.Reset();
+	int32 Unrewound = 0;
+
+	// tracks any trace reaches, each once
+	FRewindTrackIds Tracks;
+	FRewindTrackIds TraceTracks;
+	for (const FVector& TraceEnd : TraceEnds)
+	{
+		TraceTracks.Reset();
+		Broadphase.QuerySegment(TraceStart, TraceEnd, TraceTracks);
+		for (int32 Track : TraceTracks)
+		{
+			Tracks.AddUnique(Track);
+		}
+	}
+	INC_DWORD_STAT_BY(STAT_SSRBroadphaseTracks, Tracks.Num());
+
+	for (int32 Track : Tracks)
+	{
+		ABlasterCharacter* Character = TrackCharacters[Track].Get();
+		if (Character == nullptr || Character == IgnoreCharacter) continue;
+
+		FCapsuleFrameBracket Bracket;
+		if (!History.FindFrames(Track, HitTime, Bracket))
+		{
+			++Unrewound;
+			continue;
+		}
+
+		// the broadphase only knows the whole history's bounds
+		const bool bReached = Algo::AnyOf(TraceEnds, [&Bracket, &TraceStart](const FVector& TraceEnd)
+			{
+				return FMath::LineBoxIntersection(Bracket.Bounds, TraceStart, TraceEnd, TraceEnd - TraceStart);
+			});
+		if (!bReached) continue;
+		OutVictims.Add(FRewindVictim{ Character, MoveTemp(Bracket) });
+	}
+	return Unrewound;
+}
+
+bool ULagCompensationSubsystem::CreateTrack(FRecordedCharacter& Recorded)
+{
+	RemoveTrack(Recorded);
+
+	ULagCompensationComponent* LagCompensation = Recorded.LagCompensation.Get();
+	ABlasterCharacter* Character = Recorded.Character.Get();
+	USkeletalMeshComponent* Mesh = Character ? Character->GetMesh() : nullptr;
+	if (LagCompensation == nullptr || Mesh == nullptr || Mesh->GetPhysicsAsset() == nullptr) return false;
+
+	Recorded.PhysicsAsset = Mesh->GetPhysicsAsset();
+	Recorded.SkinnedAsset = Mesh->GetSkinnedAsset();
+	Recorded.KeyPositions.Reset();
+	Recorded.MinRecordInterval = LagCompensation->GetMinRecordInterval();
+	Recorded.LastRecordTime = TNumericLimits<float>::Lowest();
+	Recorded.Track = History.AddTrack(GetCapsuleLayout(Mesh), LagCompensation->GetHistoryCapacity(), LagCompensation->MaxRecordTime);
+	LagCompensation->RewindTrack = Recorded.Track;
+	if (Recorded.Track >= TrackCharacters.Num())
+	{
+		TrackCharacters.SetNum(Recorded.Track + 1);
+	}
+	TrackCharacters[Recorded.Track] = Character;
+	return true;
+}
+
+void ULagCompensationSubsystem::RemoveTrack(FRecordedCharacter& Recorded)
+{
+	if (Recorded.Track == INDEX_NONE) return;
+	History.RemoveTrack(Recorded.Track);
+	Broadphase.Remove(Recorded.Track);
+	TrackCharacters[Recorded.Track] = nullptr;
+	Recorded.Track = INDEX_NONE;
+}
+
+void ULagCompensationSubsystem::RecordFrame(FRecordedCharacter& Recorded, float Time)
+{
+	ABlasterCharacter* Character = Recorded.Character.Get();
+	USkeletalMeshComponent* Mesh = Character ? Character->GetMesh() : nullptr;
+	if (Mesh == nullptr || Mesh->GetPhysicsAsset() == nullptr) return;
+
+	// frames saved with another physics asset can't be interpolated against new ones
+	if (Recorded.Track == INDEX_NONE || Recorded.PhysicsAsset.Get() != Mesh->GetPhysicsAsset() || Recorded.SkinnedAsset.Get() != Mesh->GetSkinnedAsset())
+	{
+		if (!CreateTrack(Recorded)) return;
+	}
+
+	// the track only has room for frames this far apart, any closer and its oldest frames would be overwritten early
+	if (Time - Recorded.LastRecordTime < Recorded.MinRecordInterval) return;
+
+	const TArray<FTransform>& ComponentSpaceTransforms = Mesh->GetComponentSpaceTransforms();
+	if (ComponentSpaceTransforms.IsEmpty()) return;
+	Recorded.LastRecordTime = Time;
+
+	const bool bForceKeyframe = ForcesKeyframe(Recorded);
+	Recorder.RecordFrame(Recorded.Track, Time, ComponentSpaceTransforms, Mesh->GetComponentTransform(), CVarRecordTolerance.GetValueOnGameThread(), bForceKeyframe, Recorded.KeyPositions);
+}
+
+bool ULagCompensationSubsystem::ForcesKeyframe(FRecordedCharacter& Recorded)
+{
+	ABlasterCharacter* Character = Recorded.Character.Get();
+	UAnimInstance* AnimInstance = Character->GetMesh()->GetAnimInstance();
+	UAnimMontage* Montage = AnimInstance ? AnimInstance->GetCurrentActiveMontage() : nullptr;
+	const FVector RootLocation = Character->GetActorLocation();
+	const bool bTeleported = FVector::DistSquared(RootLocation, Recorded.LastRootLocation) > FMath::Square(TeleportDistance);
+	Recorded.LastRootLocation = RootLocation;
+
+	const bool bMontageChanged = Montage != Recorded.KeyMontage.Get();
+	Recorded.KeyMontage = Montage;
+	return bTeleported || bMontageChanged;
+}
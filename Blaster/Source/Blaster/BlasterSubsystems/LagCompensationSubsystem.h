@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+#include "Blaster/BlasterTypes/RewindBroadphase.h"
+#include "Blaster/BlasterTypes/RewindRecorder.h"
+#include "Blaster/BlasterTypes/RewindCapture.h"
+#include "LagCompensationSubsystem.generated.h"
+
+// A character a rewound trace reaches, see ULagCompensationSubsystem::FindRewindCandidates
+struct FRewindCandidate
+{
+	class ABlasterCharacter* Character = nullptr;
+
+	// distance along the trace to the rewound body bounds
+	double Distance = 0.0;
+};
+
+// A character any of several rewound traces reaches, with its frames at the rewind time.
+// See ULagCompensationSubsystem::FindRewindVictims
+struct FRewindVictim
+{
+	ABlasterCharacter* Character = nullptr;
+	FCapsuleFrameBracket Bracket;
+};
+
+/**
+ * Server-side rewind for the whole world. Ticks once per frame after the tick groups, so animation is final:
+ * rewinds the score requests queued since the last tick, then records every lag compensated character's capsules
+ * into one FRewindHistory.
+ */
+UCLASS()
+class BLASTER_API ULagCompensationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void Register(class ULagCompensationComponent* LagCompensation);
+	void Unregister(ULagCompensationComponent* LagCompensation);
+
+	bool GetFrameBracket(const ABlasterCharacter* HitCharacter, float HitTime, FCapsuleFrameBracket& OutBracket) const;
+
+	// Every lag compensated character whose body bounds at HitTime the trace passes through, nearest first.
+	// Lets the server decide who a shot hit instead of trusting the client, including players in front of the client's target.
+	// Returns how many characters the trace may have reached that have no saved frames at HitTime.
+	int32 FindRewindCandidates(
+		const FVector& TraceStart,
+		const FVector& TraceEnd,
+		float HitTime,
+		const ABlasterCharacter* IgnoreCharacter,
+		TArray<FRewindCandidate, TInlineAllocator<8>>& OutCandidates
+	) const;
+
+	// Every lag compensated character whose body bounds at HitTime any of the traces from TraceStart passes through,
+	// each bracketed once however many traces reach it. For spread shots like the shotgun's.
+	// Returns how many characters the traces may have reached that have no saved frames at HitTime.
+	int32 FindRewindVictims(
+		const FVector& TraceStart,
+		TArrayView<const FVector> TraceEnds,
+		float HitTime,
+		const ABlasterCharacter* IgnoreCharacter,
+		TArray<FRewindVictim, TInlineAllocator<4>>& OutVictims
+	) const;
+
+	// Fraction of TraceStart -> TraceEnd that static world geometry leaves clear, 1 if nothing blocks it.
+	// Static geometry hasn't moved since the shot, so this traces the present world. Traces between the same
+	// OcclusionCacheGrid cells share one result for the rest of the tick.
+	float GetStaticOcclusion(const FVector& TraceStart, const FVector& TraceEnd);
+
+	// Takes Cost tokens from the score request budget of Requester's client connection, false if it can't afford them.
+	// The budget refills at Rate tokens a second up to Burst seconds' worth. Local players are never limited.
+	bool ConsumeScoreRequestBudget(const AActor* Requester, float Cost, float Rate, float Burst);
+
+	// Records a rewind into the capture while Blaster.SSR.CaptureRewinds names a file, see FRewindCapture
+	FORCEINLINE bool IsCapturingRewinds() const { return !CapturePath.IsEmpty(); }
+	void CaptureRewind(const FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius, EHitbox HitType, const FVector& HitLocation, const FVector& HitNormal);
+
+	FORCEINLINE const FRewindHistory& GetHistory() const { return History; }
+
+	// Adds a shooter's rewound requests and batches to this tick's requests per batch stat
+	FORCEINLINE void CountRewindBatches(int32 NumRequests, int32 NumBatches)
+	{
+		TickScoreRequests += NumRequests;
+		TickRewindBatches += NumBatches;
+	}
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FRecordedCharacter
+	{
+		TWeakObjectPtr<ULagCompensationComponent> LagCompensation;
+		TWeakObjectPtr<ABlasterCharacter> Character;
+
+		// assets the track's layout was built from
+		TWeakObjectPtr<class UPhysicsAsset> PhysicsAsset;
+		TWeakObjectPtr<class USkinnedAsset> SkinnedAsset;
+
+		int32 Track = INDEX_NONE;
+
+		// frames are recorded at most once every MinRecordInterval, however fast the server ticks
+		float MinRecordInterval = 0.f;
+		float LastRecordTime = TNumericLimits<float>::Lowest();
+
+		// full precision end points of the newest stored frame, later poses are compared against them
+		TArray<float> KeyPositions;
+		TWeakObjectPtr<class UAnimMontage> KeyMontage;
+		FVector LastRootLocation = FVector::ZeroVector;
+	};
+
+	// Layout of a mesh's physics asset, built the first time it is seen and shared by every character using it
+	FCapsuleLayoutPtr GetCapsuleLayout(class USkeletalMeshComponent* Mesh);
+
+	bool CreateTrack(FRecordedCharacter& Recorded);
+	void RecordFrame(FRecordedCharacter& Recorded, float Time);
+
+	// Whether the character did something that always stores a new frame, a montage change or a teleport.
+	// Otherwise Recorder stores one once any end point moves further than Blaster.SSR.RecordTolerance
+	bool ForcesKeyframe(FRecordedCharacter& Recorded);
+
+	void RemoveTrack(FRecordedCharacter& Recorded);
+
+	TArray<FRecordedCharacter> RecordedCharacters;
+	FRewindHistory History;
+	FRewindBroadphase Broadphase;
+
+	// indexed by track id
+	TArray<TWeakObjectPtr<ABlasterCharacter>> TrackCharacters;
+
+	// stores the recorded characters' poses into History and Broadphase
+	FRewindRecorder Recorder{ History, Broadphase };
+
+	// score requests and rewind batches of every shooter processed this tick
+	uint32 TickScoreRequests = 0;
+	uint32 TickRewindBatches = 0;
+
+	// token bucket of one client connection, a token is one rewound trace
+	struct FScoreRequestBudget
+	{
+		float Tokens = 0.f;
+		double LastRefillTime = 0.0;
+		uint32 Accepted = 0;
+		uint32 Dropped = 0;
+	};
+	TMap<TWeakObjectPtr<class UNetConnection>, FScoreRequestBudget> ScoreRequestBudgets;
+
+	// rewinds captured since Blaster.SSR.CaptureRewinds was set to CapturePath, written out once it changes
+	FRewindCapture Capture;
+	FString CapturePath;
+	void UpdateCapture();
+	void SaveCapture();
+
+	// static occlusion results of this tick, keyed by the grid cells of the trace's start and end
+	typedef TPair<FIntVector, FIntVector> FOcclusionKey;
+	TMap<FOcclusionKey, float> OcclusionCache;
+	static constexpr float OcclusionCacheGrid = 2.f;
+
+	// bone indices depend on the skeleton as well as the physics asset
+	typedef TPair<TWeakObjectPtr<UPhysicsAsset>, TWeakObjectPtr<USkinnedAsset>> FLayoutKey;
+	TMap<FLayoutKey, FCapsuleLayoutPtr> LayoutCache;
+};
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+/**
+* Headless tools for the rewind pipeline, no world, characters or network needed.
+* Recording and rewinding are benchmarked by the Blaster.SSR.Benchmark.RecordAndRewind automation test.
+*
+*   Blaster.SSR.ReplayCapture <File> [ToleranceCm=0.1]
+* Traces every rewind of a capture written with Blaster.SSR.CaptureRewinds again and compares the hits with the ones
+* the server reported when it was captured. Relative paths are under Saved/, mismatches are logged as errors.
+*/
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+#include "Blaster/BlasterTypes/RewindCapture.h"
+#include "Blaster/BlasterComponents/LagCompensationComponent.h"
+
+namespace RewindReplay
+{
+	static void ReplayCapture(const TArray<FString>& Args, FOutputDevice& Ar)
+	{
+		if (!Args.IsValidIndex(0))
+		{
+			Ar.Logf(ELogVerbosity::Error, TEXT("Blaster.SSR.ReplayCapture: no capture file given"));
+			return;
+		}
+		const FString Filename = FPaths::IsRelative(Args[0]) ? FPaths::Combine(FPaths::ProjectSavedDir(), Args[0]) : Args[0];
+		const float Tolerance = Args.IsValidIndex(1) ? FMath::Max(0.f, FCString::Atof(*Args[1])) : 0.1f;
+
+		FRewindCapture Capture;
+		if (!Capture.Load(Filename))
+		{
+			Ar.Logf(ELogVerbosity::Error, TEXT("Blaster.SSR.ReplayCapture: couldn't load %s"), *Filename);
+			return;
+		}
+
+		static constexpr int32 MaxReported = 10;
+		int32 TypeMismatches = 0;
+		int32 LocationMismatches = 0;
+		for (int32 i = 0; i < Capture.Num(); ++i)
+		{
+			const FRewindCapture::FRecord& Record = Capture[i];
+			FCapsuleFrameBracket Bracket = Capture.MakeBracket(i);
+			const FHitInfo HitInfo = ULagCompensationComponent::TraceAgainstCapsules(Bracket, Record.TraceStart, Record.TraceEnd, Record.TraceRadius);
+
+			// where a miss lands means nothing
+			const bool bTypeMatches = HitInfo.HitType == Record.HitType;
+			const bool bLocationMatches = !bTypeMatches || HitInfo.HitType == EHitbox::EH_None || FVector::Dist(HitInfo.Location, Record.HitLocation) <= Tolerance;
+			if (bTypeMatches && bLocationMatches) continue;
+
+			if (TypeMismatches + LocationMismatches < MaxReported)
+			{
+				Ar.Logf(ELogVerbosity::Error, TEXT("  rewind %d: captured %s at %s, replayed %s at %s"), i,
+					*UEnum::GetValueAsString(Record.HitType), *Record.HitLocation.ToString(),
+					*UEnum::GetValueAsString(HitInfo.HitType), *HitInfo.Location.ToString());
+			}
+			if (bTypeMatches)
+			{
+				++LocationMismatches;
+			}
+			else
+			{
+				++TypeMismatches;
+			}
+		}
+
+		const ELogVerbosity::Type Verbosity = TypeMismatches + LocationMismatches > 0 ? ELogVerbosity::Error : ELogVerbosity::Display;
+		Ar.Logf(Verbosity, TEXT("Blaster.SSR.ReplayCapture: %d rewinds from %s, %d hit type mismatches, %d more than %.2f cm off"),
+			Capture.Num(), *Filename, TypeMismatches, LocationMismatches, Tolerance);
+	}
+
+	static FAutoConsoleCommandWithArgsAndOutputDevice ReplayCaptureCommand(
+		TEXT("Blaster.SSR.ReplayCapture"),
+		TEXT("Replays a capture written with Blaster.SSR.CaptureRewinds and reports hits that changed. Args: <File> [ToleranceCm]"),
+		FConsoleCommandWithArgsAndOutputDeviceDelegate::CreateStatic(&ReplayCapture)
+	);
+}
@@ -0,0 +1,235 @@
+#include "CapsuleTrace.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarScalarCapsuleTrace(
+	TEXT("Blaster.SSR.ScalarCapsuleTrace"),
+	false,
+	TEXT("Use the scalar ray vs capsule test for server-side rewind instead of the vectorised one."),
+	ECVF_Default
+);
+
+/**
+* Both overlap tests find the closest points between the trace and each capsule axis
+* (Real-Time Collision Detection, 5.1.9) and compare their distance against the capsule radius.
+* Everything is relative to the trace start with a unit direction, which keeps the float math well conditioned.
+*/
+
+void FCapsuleTrace::OverlapCapsules(const float* Positions, const float* Radii, int32 NumCapsules, int32 Stride, const FVector& Start, const FVector& End, FCapsuleIndices& OutHits)
+{
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+	if (CVarScalarCapsuleTrace.GetValueOnAnyThread())
+#endif
+	{
+		OverlapCapsulesScalar(Positions, Radii, NumCapsules, Stride, Start, End, OutHits);
+		return;
+	}
+
+	const FVector Ray = End - Start;
+	const double Length = Ray.Size();
+	if (Length < UE_KINDA_SMALL_NUMBER) return;
+	const FVector3f Dir = FVector3f(Ray / Length);
+
+	const VectorRegister4Float OriginX = VectorSetFloat1(Start.X);
+	const VectorRegister4Float OriginY = VectorSetFloat1(Start.Y);
+	const VectorRegister4Float OriginZ = VectorSetFloat1(Start.Z);
+	const VectorRegister4Float DirX = VectorSetFloat1(Dir.X);
+	const VectorRegister4Float DirY = VectorSetFloat1(Dir.Y);
+	const VectorRegister4Float DirZ = VectorSetFloat1(Dir.Z);
+	const VectorRegister4Float TraceLength = VectorSetFloat1(Length);
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float Epsilon = VectorSetFloat1(UE_SMALL_NUMBER);
+
+	for (int32 Base = 0; Base < NumCapsules; Base += Width)
+	{
+		const VectorRegister4Float RawAX = VectorLoad(Positions + Base);
+		const VectorRegister4Float RawAY = VectorLoad(Positions + Stride + Base);
+		const VectorRegister4Float RawAZ = VectorLoad(Positions + 2 * Stride + Base);
+
+		// capsule start relative to the trace start, and capsule axis
+		const VectorRegister4Float AX = VectorSubtract(RawAX, OriginX);
+		const VectorRegister4Float AY = VectorSubtract(RawAY, OriginY);
+		const VectorRegister4Float AZ = VectorSubtract(RawAZ, OriginZ);
+		const VectorRegister4Float AxisX = VectorSubtract(VectorLoad(Positions + 3 * Stride + Base), RawAX);
+		const VectorRegister4Float AxisY = VectorSubtract(VectorLoad(Positions + 4 * Stride + Base), RawAY);
+		const VectorRegister4Float AxisZ = VectorSubtract(VectorLoad(Positions + 5 * Stride + Base), RawAZ);
+
+		const VectorRegister4Float E = VectorMultiplyAdd(AxisZ, AxisZ, VectorMultiplyAdd(AxisY, AxisY, VectorMultiply(AxisX, AxisX)));
+		const VectorRegister4Float B = VectorMultiplyAdd(DirZ, AxisZ, VectorMultiplyAdd(DirY, AxisY, VectorMultiply(DirX, AxisX)));
+		const VectorRegister4Float DirDotA = VectorMultiplyAdd(DirZ, AZ, VectorMultiplyAdd(DirY, AY, VectorMultiply(DirX, AX)));
+		const VectorRegister4Float AxisDotA = VectorMultiplyAdd(AxisZ, AZ, VectorMultiplyAdd(AxisY, AY, VectorMultiply(AxisX, AX)));
+		// C = Dir . (Start - A), F = Axis . (Start - A)
+		const VectorRegister4Float C = VectorNegate(DirDotA);
+		const VectorRegister4Float F = VectorNegate(AxisDotA);
+
+		// closest point on the trace to the capsule axis line, S = 0 when they are parallel
+		const VectorRegister4Float Denom = VectorNegateMultiplyAdd(B, B, E);
+		const VectorRegister4Float SNumer = VectorSubtract(VectorMultiply(B, F), VectorMultiply(C, E));
+		const VectorRegister4Float SLine = VectorMin(VectorMax(VectorDivide(SNumer, VectorMax(Denom, Epsilon)), Zero), TraceLength);
+		const VectorRegister4Float bParallel = VectorCompareLE(Denom, VectorMultiply(E, Epsilon));
+		const VectorRegister4Float S0 = VectorSelect(bParallel, Zero, SLine);
+
+		// closest point on the capsule axis, degenerate capsules are spheres at A
+		const VectorRegister4Float bDegenerate = VectorCompareLE(E, Epsilon);
+		const VectorRegister4Float TRaw = VectorDivide(VectorMultiplyAdd(B, S0, F), VectorMax(E, Epsilon));
+		const VectorRegister4Float T = VectorSelect(bDegenerate, Zero, VectorMin(VectorMax(TRaw, Zero), One));
+
+		// T was clamped, recompute the closest point on the trace
+		const VectorRegister4Float bRecompute = VectorBitwiseOr(VectorCompareNE(T, TRaw), bDegenerate);
+		const VectorRegister4Float SClamped = VectorMin(VectorMax(VectorSubtract(VectorMultiply(B, T), C), Zero), TraceLength);
+		const VectorRegister4Float S = VectorSelect(bRecompute, SClamped, S0);
+
+		// (Dir * S) - (A + Axis * T)
+		const VectorRegister4Float DX = VectorSubtract(VectorMultiply(DirX, S), VectorMultiplyAdd(AxisX, T, AX));
+		const VectorRegister4Float DY = VectorSubtract(VectorMultiply(DirY, S), VectorMultiplyAdd(AxisY, T, AY));
+		const VectorRegister4Float DZ = VectorSubtract(VectorMultiply(DirZ, S), VectorMultiplyAdd(AxisZ, T, AZ));
+		const VectorRegister4Float DistSquared = VectorMultiplyAdd(DZ, DZ, VectorMultiplyAdd(DY, DY, VectorMultiply(DX, DX)));
+
+		const VectorRegister4Float Radius = VectorLoad(Radii + Base);
+		int32 HitBits = VectorMaskBits(VectorCompareLE(DistSquared, VectorMultiply(Radius, Radius)));
+
+		// ignore the padding at the end of the arrays
+		const int32 Remaining = NumCapsules - Base;
+		if (Remaining < Width)
+		{
+			HitBits &= (1 << Remaining) - 1;
+		}
+		while (HitBits)
+		{
+			const int32 Lane = FMath::CountTrailingZeros(static_cast<uint32>(HitBits));
+			OutHits.Add(Base + Lane);
+			HitBits &= HitBits - 1;
+		}
+	}
+}
+
+void FCapsuleTrace::OverlapCapsulesScalar(const float* Positions, const float* Radii, int32 NumCapsules, int32 Stride, const FVector& Start, const FVector& End, FCapsuleIndices& OutHits)
+{
+	const FVector Ray = End - Start;
+	const double Length = Ray.Size();
+	if (Length < UE_KINDA_SMALL_NUMBER) return;
+	const FVector3f Dir = FVector3f(Ray / Length);
+	const FVector3f Origin = FVector3f(Start);
+	const float TraceLength = Length;
+
+	for (int32 i = 0; i < NumCapsules; ++i)
+	{
+		const FVector3f RawA(Positions[i], Positions[Stride + i], Positions[2 * Stride + i]);
+		const FVector3f RawB(Positions[3 * Stride + i], Positions[4 * Stride + i], Positions[5 * Stride + i]);
+		const FVector3f A = RawA - Origin;
+		const FVector3f Axis = RawB - RawA;
+
+		const float E = Axis | Axis;
+		const float B = Dir | Axis;
+		const float C = -(Dir | A);
+		const float F = -(Axis | A);
+
+		const float Denom = E - B * B;
+		float S = Denom > E * UE_SMALL_NUMBER ? FMath::Clamp((B * F - C * E) / Denom, 0.f, TraceLength) : 0.f;
+		float T = 0.f;
+		if (E > UE_SMALL_NUMBER)
+		{
+			const float TRaw = (B * S + F) / E;
+			T = FMath::Clamp(TRaw, 0.f, 1.f);
+			if (T != TRaw)
+			{
+				S = FMath::Clamp(B * T - C, 0.f, TraceLength);
+			}
+		}
+		else
+		{
+			S = FMath::Clamp(-C, 0.f, TraceLength);
+		}
+
+		const FVector3f Delta = Dir * S - (A + Axis * T);
+		if ((Delta | Delta) <= Radii[i] * Radii[i])
+		{
+			OutHits.Add(i);
+		}
+	}
+}
+
+void FCapsuleTrace::LerpCapsules(const int16* Older, const int16* Younger, int32 Stride, int32 Base, const FVector3f& OlderOrigin, const FVector3f& YoungerOrigin, float Step, float Alpha, float* OutCapsules)
+{
+	checkSlow(Base % Width == 0 && Base + Width <= Stride);
+	// lerping the origins and the offsets separately is the same as lerping the decoded points
+	const FVector3f Origin = FMath::Lerp(OlderOrigin, YoungerOrigin, Alpha);
+	for (int32 Component = 0; Component < 6; ++Component)
+	{
+		const float ComponentOrigin = Origin[Component % 3];
+		const int16* OlderComponent = Older + Component * Stride + Base;
+		const int16* YoungerComponent = Younger + Component * Stride + Base;
+		float* OutComponent = OutCapsules + Component * Width;
+		for (int32 Lane = 0; Lane < Width; ++Lane)
+		{
+			OutComponent[Lane] = ComponentOrigin + Step * FMath::Lerp(float(OlderComponent[Lane]), float(YoungerComponent[Lane]), Alpha);
+		}
+	}
+}
+
+static bool SegmentSphereIntersection(const FVector& Start, const FVector& Dir, const FVector& Center, double Radius, double& OutDistance)
+{
+	const FVector ToStart = Start - Center;
+	const double B = Dir | ToStart;
+	const double C = (ToStart | ToStart) - Radius * Radius;
+	const double H = B * B - C;
+	if (H < 0.0) return false;
+	OutDistance = -B - FMath::Sqrt(H);
+	return OutDistance >= 0.0;
+}
+
+bool FCapsuleTrace::SegmentCapsuleIntersection(const FVector& Start, const FVector& Dir, double Length, const FVector& A, const FVector& B, double Radius, double& OutDistance)
+{
+	const FVector BA = B - A;
+	const FVector OA = Start - A;
+	const double BABA = BA | BA;
+	const double BAOA = BA | OA;
+	const double RadiusSq = Radius * Radius;
+
+	// starting inside the capsule
+	const double StartT = BABA > UE_SMALL_NUMBER ? FMath::Clamp(BAOA / BABA, 0.0, 1.0) : 0.0;
+	if ((OA - BA * StartT).SizeSquared() <= RadiusSq)
+	{
+		OutDistance = 0.0;
+		return true;
+	}
+
+	// the first contact is the nearest of the cylinder body and the two end spheres
+	double Best = TNumericLimits<double>::Max();
+	const double BARD = BA | Dir;
+	const double QA = BABA - BARD * BARD;
+	if (BABA > UE_SMALL_NUMBER && QA > UE_SMALL_NUMBER)
+	{
+		const double QB = BABA * (Dir | OA) - BAOA * BARD;
+		const double QC = BABA * (OA | OA) - BAOA * BAOA - RadiusSq * BABA;
+		const double H = QB * QB - QA * QC;
+		if (H < 0.0) return false; // misses the infinite cylinder around the axis, so it misses the capsule
+
+		const double Distance = (-QB - FMath::Sqrt(H)) / QA;
+		const double Y = BAOA + Distance * BARD;
+		if (Distance >= 0.0 && Y > 0.0 && Y < BABA)
+		{
+			Best = Distance;
+		}
+	}
+
+	double SphereDistance;
+	if (SegmentSphereIntersection(Start, Dir, A, Radius, SphereDistance))
+	{
+		Best = FMath::Min(Best, SphereDistance);
+	}
+	if (SegmentSphereIntersection(Start, Dir, B, Radius, SphereDistance))
+	{
+		Best = FMath::Min(Best, SphereDistance);
+	}
+
+	if (Best > Length) return false;
+	OutDistance = Best;
+	return true;
+}
+
+FVector FCapsuleTrace::CapsuleNormal(const FVector& Point, const FVector& A, const FVector& B)
+{
+	const FVector ClosestOnAxis = FMath::ClosestPointOnSegment(Point, A, B);
+	return (Point - ClosestOnAxis).GetSafeNormal();
+}
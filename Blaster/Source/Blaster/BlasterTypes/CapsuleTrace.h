@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Indices of the capsules a trace passes through. Inline so a shot never allocates.
+typedef TArray<int32, TInlineAllocator<32>> FCapsuleIndices;
+
+/**
+* Ray vs capsule tests for server-side rewind.
+* Capsules are read structure-of-arrays: Positions holds AX, AY, AZ, BX, BY, BZ arrays,
+* each Stride floats long. Stride is a multiple of 4 so the arrays can be read 4 capsules at a time.
+*/
+struct FCapsuleTrace
+{
+	static constexpr int32 Width = 4;
+
+	static FORCEINLINE int32 GetStride(int32 NumCapsules) { return Align(NumCapsules, Width); }
+
+	// Adds the index of every capsule the segment Start -> End touches to OutHits.
+	// Exact segment vs swept sphere distance test, 4 capsules per iteration.
+	static void OverlapCapsules(const float* Positions, const float* Radii, int32 NumCapsules, int32 Stride, const FVector& Start, const FVector& End, FCapsuleIndices& OutHits);
+
+	// Same test one capsule at a time, used when vector intrinsics are unavailable or Blaster.SSR.ScalarCapsuleTrace is set
+	static void OverlapCapsulesScalar(const float* Positions, const float* Radii, int32 NumCapsules, int32 Stride, const FVector& Start, const FVector& End, FCapsuleIndices& OutHits);
+
+	// Decodes and lerps the Width capsules starting at Base from two quantised SoA frames into OutCapsules,
+	// a SoA block with a stride of Width. A frame's end points are Origin + Offset * Step. Base must be a multiple of Width.
+	static void LerpCapsules(const int16* Older, const int16* Younger, int32 Stride, int32 Base, const FVector3f& OlderOrigin, const FVector3f& YoungerOrigin, float Step, float Alpha, float* OutCapsules);
+
+	// Distance along Dir from Start to where the segment first touches the capsule A-B.
+	// Returns false if the segment misses. A segment starting inside the capsule hits at distance 0.
+	static bool SegmentCapsuleIntersection(const FVector& Start, const FVector& Dir, double Length, const FVector& A, const FVector& B, double Radius, double& OutDistance);
+
+	// Surface normal of the capsule A-B at Point
+	static FVector CapsuleNormal(const FVector& Point, const FVector& A, const FVector& B);
+};
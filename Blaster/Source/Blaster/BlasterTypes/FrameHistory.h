@@ -0,0 +1,116 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+* Fixed-capacity ring buffer of frames used for server-side rewind.
+* Every slot is allocated once in Init() and reused, so recording a frame never allocates.
+* Index 0 is the oldest frame and Num() - 1 is the newest.
+*/
+template<typename FrameType>
+class TFrameHistory
+{
+public:
+	void Init(int32 InCapacity)
+	{
+		check(InCapacity > 0);
+		Frames.Empty(InCapacity);
+		Frames.SetNum(InCapacity);
+		Head = 0;
+		Count = 0;
+	}
+
+	void Reset()
+	{
+		Head = 0;
+		Count = 0;
+	}
+
+	FORCEINLINE int32 Num() const { return Count; }
+	FORCEINLINE int32 Capacity() const { return Frames.Num(); }
+	FORCEINLINE bool IsEmpty() const { return Count == 0; }
+	FORCEINLINE bool IsFull() const { return Count == Frames.Num(); }
+
+	FORCEINLINE FrameType& operator[](int32 Index) { return Frames[SlotIndex(Index)]; }
+	FORCEINLINE const FrameType& operator[](int32 Index) const { return Frames[SlotIndex(Index)]; }
+
+	FORCEINLINE FrameType& Oldest() { return (*this)[0]; }
+	FORCEINLINE const FrameType& Oldest() const { return (*this)[0]; }
+	FORCEINLINE FrameType& Newest() { return (*this)[Count - 1]; }
+	FORCEINLINE const FrameType& Newest() const { return (*this)[Count - 1]; }
+
+	// Returns the slot for a new frame. When the history is full the oldest frame is overwritten.
+	// The slot still holds whatever frame was stored there before, the caller is expected to overwrite it.
+	FrameType& AddNewest()
+	{
+		check(Frames.Num() > 0);
+		if (IsFull())
+		{
+			RemoveOldest();
+		}
+		++Count;
+		return Newest();
+	}
+
+	void RemoveOldest()
+	{
+		if (Count == 0) return;
+		Head = (Head + 1) % Frames.Num();
+		--Count;
+	}
+
+	// Binary search for the frames either side of Time. Frames are expected to be added in time order.
+	// OutOlder == OutYounger when no interpolation is needed: Time matches a frame exactly or is at/after the newest frame.
+	// Returns false when the history is empty or Time is older than the oldest frame.
+	bool FindFramesAround(float Time, int32& OutOlder, int32& OutYounger) const
+	{
+		if (Count == 0 || Oldest().Time > Time) return false;
+		if (Newest().Time <= Time)
+		{
+			OutOlder = OutYounger = Count - 1;
+			return true;
+		}
+
+		// first frame younger than Time, Oldest <= Time < Newest so it is in [1, Count - 1]
+		int32 Low = 1;
+		int32 High = Count - 1;
+		while (Low < High)
+		{
+			const int32 Mid = Low + (High - Low) / 2;
+			if ((*this)[Mid].Time > Time)
+			{
+				High = Mid;
+			}
+			else
+			{
+				Low = Mid + 1;
+			}
+		}
+		OutYounger = Low;
+		OutOlder = Low - 1;
+		if ((*this)[OutOlder].Time == Time)
+		{
+			OutYounger = OutOlder;
+		}
+		return true;
+	}
+
+	SIZE_T GetAllocatedSize() const { return Frames.GetAllocatedSize(); }
+
+	// Slot in [0, Capacity) that holds frame Index. A slot keeps its position for the lifetime of the history,
+	// so callers can keep per-frame data in their own arrays indexed by slot.
+	FORCEINLINE int32 SlotIndex(int32 Index) const
+	{
+		checkSlow(Index >= 0 && Index < Count);
+		const int32 Slot = Head + Index;
+		return Slot < Frames.Num() ? Slot : Slot - Frames.Num();
+	}
+
+private:
+
+	TArray<FrameType> Frames;
+
+	// slot of the oldest frame
+	int32 Head = 0;
+	int32 Count = 0;
+};
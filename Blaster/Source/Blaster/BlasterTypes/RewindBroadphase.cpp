@@ -0,0 +1,185 @@
+#include "RewindBroadphase.h"
+
+FRewindBroadphase::FRewindBroadphase(float InCellSize)
+	: CellSize(InCellSize)
+{
+	check(CellSize > 0.f);
+}
+
+FIntPoint FRewindBroadphase::GetCell(double X, double Y) const
+{
+	return FIntPoint(FMath::FloorToInt(X / CellSize), FMath::FloorToInt(Y / CellSize));
+}
+
+void FRewindBroadphase::AddToCells(int32 TrackId, const FIntRect& CellRect)
+{
+	for (int32 Y = CellRect.Min.Y; Y <= CellRect.Max.Y; ++Y)
+	{
+		for (int32 X = CellRect.Min.X; X <= CellRect.Max.X; ++X)
+		{
+			Cells.FindOrAdd(FIntPoint(X, Y)).Add(TrackId);
+		}
+	}
+}
+
+void FRewindBroadphase::RemoveFromCells(int32 TrackId, const FIntRect& CellRect)
+{
+	for (int32 Y = CellRect.Min.Y; Y <= CellRect.Max.Y; ++Y)
+	{
+		for (int32 X = CellRect.Min.X; X <= CellRect.Max.X; ++X)
+		{
+			const FIntPoint Cell(X, Y);
+			if (auto* CellTracks = Cells.Find(Cell))
+			{
+				CellTracks->RemoveSingleSwap(TrackId, EAllowShrinking::No);
+				if (CellTracks->IsEmpty())
+				{
+					Cells.Remove(Cell);
+				}
+			}
+		}
+	}
+}
+
+void FRewindBroadphase::RemoveOversized(int32 TrackId)
+{
+	OversizedTracks.RemoveSingleSwap(TrackId, EAllowShrinking::No);
+}
+
+void FRewindBroadphase::Update(int32 TrackId, const FBox3f& Bounds)
+{
+	check(TrackId >= 0);
+	if (!Bounds.IsValid)
+	{
+		Remove(TrackId);
+		return;
+	}
+	if (TrackId >= Entries.Num())
+	{
+		Entries.SetNum(TrackId + 1);
+	}
+
+	FEntry& Entry = Entries[TrackId];
+	Entry.Bounds = Bounds;
+
+	const FIntPoint MinCell = GetCell(Bounds.Min.X, Bounds.Min.Y);
+	const FIntPoint MaxCell = GetCell(Bounds.Max.X, Bounds.Max.Y);
+	const FIntRect NewCells(MinCell, MaxCell);
+	const bool bOversized = int64(NewCells.Width() + 1) * int64(NewCells.Height() + 1) > MaxCellsPerTrack;
+
+	// the usual case, still inside the same cells
+	if (Entry.bValid && !bOversized && !Entry.bOversized && Entry.Cells == NewCells) return;
+
+	if (Entry.bValid)
+	{
+		if (Entry.bOversized)
+		{
+			RemoveOversized(TrackId);
+		}
+		else
+		{
+			RemoveFromCells(TrackId, Entry.Cells);
+		}
+	}
+
+	Entry.bValid = true;
+	Entry.bOversized = bOversized;
+	if (bOversized)
+	{
+		Entry.Cells = FIntRect(0, 0, -1, -1);
+		OversizedTracks.Add(TrackId);
+	}
+	else
+	{
+		Entry.Cells = NewCells;
+		AddToCells(TrackId, NewCells);
+	}
+}
+
+void FRewindBroadphase::Remove(int32 TrackId)
+{
+	if (!Entries.IsValidIndex(TrackId) || !Entries[TrackId].bValid) return;
+
+	FEntry& Entry = Entries[TrackId];
+	if (Entry.bOversized)
+	{
+		RemoveOversized(TrackId);
+	}
+	else
+	{
+		RemoveFromCells(TrackId, Entry.Cells);
+	}
+	Entry = FEntry();
+}
+
+void FRewindBroadphase::QuerySegment(const FVector& Start, const FVector& End, FRewindTrackIds& OutTracks) const
+{
+	TBitArray<TInlineAllocator<4>> Visited(false, Entries.Num());
+	auto TestTrack = [&](int32 TrackId)
+		{
+			if (Visited[TrackId]) return;
+			Visited[TrackId] = true;
+			if (FMath::LineBoxIntersection(FBox(Entries[TrackId].Bounds), Start, End, End - Start))
+			{
+				OutTracks.Add(TrackId);
+			}
+		};
+
+	for (int32 TrackId : OversizedTracks)
+	{
+		TestTrack(TrackId);
+	}
+
+	// walk the cells the segment crosses in XY (Amanatides & Woo)
+	FIntPoint Cell = GetCell(Start.X, Start.Y);
+	const FIntPoint EndCell = GetCell(End.X, End.Y);
+	const FVector2D Delta(End.X - Start.X, End.Y - Start.Y);
+	const int32 StepX = Delta.X > 0.0 ? 1 : -1;
+	const int32 StepY = Delta.Y > 0.0 ? 1 : -1;
+
+	// segment fraction to the first cell edge on each axis, and between edges
+	auto FirstCrossing = [this](double Origin, double Dir, int32 CellIndex, int32 Step)
+		{
+			if (FMath::IsNearlyZero(Dir)) return TNumericLimits<double>::Max();
+			const double Edge = (CellIndex + (Step > 0 ? 1 : 0)) * double(CellSize);
+			return (Edge - Origin) / Dir;
+		};
+	double NextX = FirstCrossing(Start.X, Delta.X, Cell.X, StepX);
+	double NextY = FirstCrossing(Start.Y, Delta.Y, Cell.Y, StepY);
+	const double StepFractionX = FMath::IsNearlyZero(Delta.X) ? TNumericLimits<double>::Max() : CellSize / FMath::Abs(Delta.X);
+	const double StepFractionY = FMath::IsNearlyZero(Delta.Y) ? TNumericLimits<double>::Max() : CellSize / FMath::Abs(Delta.Y);
+
+	const int32 MaxSteps = FMath::Abs(EndCell.X - Cell.X) + FMath::Abs(EndCell.Y - Cell.Y);
+	for (int32 Step = 0; Step <= MaxSteps; ++Step)
+	{
+		if (const auto* CellTracks = Cells.Find(Cell))
+		{
+			for (int32 TrackId : *CellTracks)
+			{
+				TestTrack(TrackId);
+			}
+		}
+		if (Cell == EndCell) break;
+
+		if (NextX < NextY)
+		{
+			Cell.X += StepX;
+			NextX += StepFractionX;
+		}
+		else
+		{
+			Cell.Y += StepY;
+			NextY += StepFractionY;
+		}
+	}
+}
+
+SIZE_T FRewindBroadphase::GetAllocatedSize() const
+{
+	SIZE_T Size = Entries.GetAllocatedSize() + Cells.GetAllocatedSize() + OversizedTracks.GetAllocatedSize();
+	for (const auto& Cell : Cells)
+	{
+		Size += Cell.Value.GetAllocatedSize();
+	}
+	return Size;
+}
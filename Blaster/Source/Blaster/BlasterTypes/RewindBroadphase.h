@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+typedef TArray<int32, TInlineAllocator<16>> FRewindTrackIds;
+
+/**
+* Uniform grid over the XY extent of every rewind track's history, so a rewound trace only looks at the tracks
+* it can reach instead of all of them.
+* A track sits in every cell its history bounds overlap and only moves when those bounds cross a cell edge,
+* so keeping it up to date each tick is cheap for the usual case. Plain C++ like FRewindHistory.
+*/
+class FRewindBroadphase
+{
+public:
+	explicit FRewindBroadphase(float InCellSize = 1000.f);
+
+	// Moves the track to the cells Bounds overlaps, adding it if it isn't in the grid yet
+	void Update(int32 TrackId, const FBox3f& Bounds);
+	void Remove(int32 TrackId);
+
+	// Tracks whose history bounds the segment passes through, each once, in no particular order
+	void QuerySegment(const FVector& Start, const FVector& End, FRewindTrackIds& OutTracks) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FEntry
+	{
+		FBox3f Bounds = FBox3f(ForceInit);
+
+		// inclusive cell range, empty while the track is in OversizedTracks or not in the grid
+		FIntRect Cells = FIntRect(0, 0, -1, -1);
+		bool bValid = false;
+		bool bOversized = false;
+	};
+
+	FIntPoint GetCell(double X, double Y) const;
+	void AddToCells(int32 TrackId, const FIntRect& Cells);
+	void RemoveFromCells(int32 TrackId, const FIntRect& Cells);
+	void RemoveOversized(int32 TrackId);
+
+	float CellSize;
+
+	// tracks spanning more cells than this are tested by every query instead, a ragdoll launched
+	// across the map shouldn't fill the grid
+	static constexpr int32 MaxCellsPerTrack = 64;
+
+	// indexed by track id
+	TArray<FEntry> Entries;
+
+	TMap<FIntPoint, TArray<int32, TInlineAllocator<4>>> Cells;
+	TArray<int32> OversizedTracks;
+};
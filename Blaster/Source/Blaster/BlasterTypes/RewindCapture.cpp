@@ -0,0 +1,158 @@
+#include "RewindCapture.h"
+#include "HAL/FileManager.h"
+
+// bump whenever the file layout or the frame encoding changes
+static constexpr uint32 RewindCaptureMagic = 0x52574E44;
+static constexpr int32 RewindCaptureVersion = 1;
+
+void FRewindCapture::Add(const FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius, EHitbox HitType, const FVector& HitLocation, const FVector& HitNormal)
+{
+	if (!Bracket.IsValid()) return;
+	const FCapsuleLayout& Layout = *Bracket.Layout;
+
+	int32* LayoutIndex = LayoutIndices.Find(Layout.Id);
+	if (LayoutIndex == nullptr)
+	{
+		// only what the trace reads
+		FCapsuleLayout& Copy = Layouts.AddDefaulted_GetRef();
+		Copy.Radii = Layout.Radii;
+		Copy.Lengths = Layout.Lengths;
+		Copy.HitboxTypes = Layout.HitboxTypes;
+		Copy.NumCapsules = Layout.NumCapsules;
+		Copy.Stride = Layout.Stride;
+		LayoutIndex = &LayoutIndices.Add(Layout.Id, Layouts.Num() - 1);
+	}
+
+	FRecord& Record = Records.AddDefaulted_GetRef();
+	Record.Layout = *LayoutIndex;
+	Record.Older = TArray<int16>(Bracket.Older, Layout.FrameValues());
+	Record.Younger = TArray<int16>(Bracket.Younger, Layout.FrameValues());
+	Record.OlderCenter = Bracket.OlderCenter;
+	Record.YoungerCenter = Bracket.YoungerCenter;
+	Record.Alpha = Bracket.Alpha;
+	Record.Bounds = Bracket.Bounds;
+	Record.TraceStart = TraceStart;
+	Record.TraceEnd = TraceEnd;
+	Record.TraceRadius = TraceRadius;
+	Record.HitType = HitType;
+	Record.HitLocation = HitLocation;
+	Record.HitNormal = HitNormal;
+}
+
+void FRewindCapture::Reset()
+{
+	Layouts.Reset();
+	LayoutIndices.Reset();
+	Records.Reset();
+}
+
+FCapsuleFrameBracket FRewindCapture::MakeBracket(int32 Index) const
+{
+	const FRecord& Record = Records[Index];
+	FCapsuleFrameBracket Bracket;
+	Bracket.Layout = &Layouts[Record.Layout];
+	Bracket.Older = Record.Older.GetData();
+	Bracket.Younger = Record.Younger.GetData();
+	Bracket.OlderCenter = Record.OlderCenter;
+	Bracket.YoungerCenter = Record.YoungerCenter;
+	Bracket.Alpha = Record.Alpha;
+	Bracket.Bounds = Record.Bounds;
+	return Bracket;
+}
+
+bool FRewindCapture::Save(const FString& Filename)
+{
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Ar) return false;
+	Serialize(*Ar);
+	return Ar->Close();
+}
+
+bool FRewindCapture::Load(const FString& Filename)
+{
+	Reset();
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileReader(*Filename));
+	if (!Ar) return false;
+	Serialize(*Ar);
+	if (Ar->IsError())
+	{
+		Reset();
+		return false;
+	}
+	return true;
+}
+
+void FRewindCapture::Serialize(FArchive& Ar)
+{
+	uint32 Magic = RewindCaptureMagic;
+	int32 Version = RewindCaptureVersion;
+	Ar << Magic << Version;
+	if (Magic != RewindCaptureMagic || Version != RewindCaptureVersion)
+	{
+		Ar.SetError();
+		return;
+	}
+
+	int32 NumLayouts = Layouts.Num();
+	Ar << NumLayouts;
+	if (Ar.IsLoading())
+	{
+		// every layout and record takes more than a byte, more than the file holds is a damaged count
+		if (NumLayouts < 0 || NumLayouts > Ar.TotalSize())
+		{
+			Ar.SetError();
+			return;
+		}
+		Layouts.SetNum(NumLayouts);
+	}
+	for (FCapsuleLayout& Layout : Layouts)
+	{
+		Ar << Layout.Radii << Layout.Lengths << Layout.NumCapsules << Layout.Stride;
+
+		// the trace reads Stride radii a group at a time and a hitbox type per capsule
+		if (Ar.IsLoading() && (Layout.Stride < 0 || Layout.Stride % FCapsuleTrace::Width != 0 || Layout.Radii.Num() != Layout.Stride
+			|| Layout.NumCapsules < 0 || Layout.NumCapsules > Layout.Stride || Layout.Lengths.Num() != Layout.NumCapsules))
+		{
+			Ar.SetError();
+			return;
+		}
+
+		int32 NumTypes = Layout.HitboxTypes.Num();
+		Ar << NumTypes;
+		if (Ar.IsLoading() && NumTypes != Layout.NumCapsules)
+		{
+			Ar.SetError();
+			return;
+		}
+		Layout.HitboxTypes.SetNum(NumTypes);
+		Ar.Serialize(Layout.HitboxTypes.GetData(), NumTypes * sizeof(EHitbox));
+	}
+
+	int32 NumRecords = Records.Num();
+	Ar << NumRecords;
+	if (Ar.IsLoading())
+	{
+		if (NumRecords < 0 || NumRecords > Ar.TotalSize())
+		{
+			Ar.SetError();
+			return;
+		}
+		Records.SetNum(NumRecords);
+	}
+	for (FRecord& Record : Records)
+	{
+		uint8 HitType = static_cast<uint8>(Record.HitType);
+		Ar << Record.Layout << Record.Older << Record.Younger << Record.OlderCenter << Record.YoungerCenter << Record.Alpha << Record.Bounds;
+		Ar << Record.TraceStart << Record.TraceEnd << Record.TraceRadius;
+		Ar << HitType << Record.HitLocation << Record.HitNormal;
+		Record.HitType = static_cast<EHitbox>(HitType);
+
+		// a damaged file must not send the replay out of bounds
+		if (Ar.IsLoading() && (!Layouts.IsValidIndex(Record.Layout)
+			|| Record.Older.Num() != Layouts[Record.Layout].FrameValues() || Record.Younger.Num() != Layouts[Record.Layout].FrameValues()))
+		{
+			Ar.SetError();
+			return;
+		}
+	}
+}
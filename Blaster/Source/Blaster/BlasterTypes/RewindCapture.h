@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+
+/**
+* Rewinds recorded on a server for regression checks: the two saved frames a trace was tested against, the trace,
+* and what it hit. Replaying a capture through the current trace code (Blaster.SSR.ReplayCapture) shows whether a
+* change to the rewind path reports different hits. Plain C++ like FRewindHistory.
+*/
+class FRewindCapture
+{
+public:
+	struct FRecord
+	{
+		int32 Layout = INDEX_NONE;
+
+		// the bracket's frames as saved in the history, see FCapsuleLayout::QuantizeStep
+		TArray<int16> Older;
+		TArray<int16> Younger;
+		FVector3f OlderCenter = FVector3f::ZeroVector;
+		FVector3f YoungerCenter = FVector3f::ZeroVector;
+		float Alpha = 0.f;
+		FBox Bounds = FBox(ForceInit);
+
+		FVector TraceStart = FVector::ZeroVector;
+		FVector TraceEnd = FVector::ZeroVector;
+		float TraceRadius = 0.f;
+
+		EHitbox HitType = EHitbox::EH_None;
+		FVector HitLocation = FVector::ZeroVector;
+		FVector HitNormal = FVector::ZeroVector;
+	};
+
+	void Add(const FCapsuleFrameBracket& Bracket, const FVector& TraceStart, const FVector& TraceEnd, float TraceRadius, EHitbox HitType, const FVector& HitLocation, const FVector& HitNormal);
+	void Reset();
+
+	FORCEINLINE int32 Num() const { return Records.Num(); }
+	FORCEINLINE bool IsEmpty() const { return Records.IsEmpty(); }
+	FORCEINLINE const FRecord& operator[](int32 Index) const { return Records[Index]; }
+
+	// A bracket over the record's frames, valid as long as this capture is
+	FCapsuleFrameBracket MakeBracket(int32 Index) const;
+
+	bool Save(const FString& Filename);
+	bool Load(const FString& Filename);
+
+private:
+	void Serialize(FArchive& Ar);
+
+	// each layout is written once however many records use it, found by FCapsuleLayout::Id
+	TArray<FCapsuleLayout> Layouts;
+	TMap<uint32, int32> LayoutIndices;
+
+	TArray<FRecord> Records;
+};
@@ -0,0 +1,352 @@
+#include "RewindHistory.h"
+#include "Blaster/Blaster.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "PhysicsEngine/SphylElem.h"
+#include <atomic>
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Lookups"), STAT_SSRFrameLookups, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lerped Groups"), STAT_SSRLerpedGroups, STATGROUP_BlasterSSR);
+
+void FCapsuleLayout::AddSphyl(const FKSphylElem& Sphyl, int32 BoneIndex, EHitbox HitboxType)
+{
+	const FTransform LocalTransform = Sphyl.GetTransform();
+	const FVector Scale = LocalTransform.GetScale3D();
+	const float Radius = Sphyl.GetScaledRadius(Scale);
+	const float Length = Sphyl.GetScaledHalfLength(Scale) - Radius;
+	const FVector LocalAxis = LocalTransform.GetUnitAxis(EAxis::Z);
+
+	Radii.Add(Radius);
+	Lengths.Add(Length);
+	HitboxTypes.Add(HitboxType);
+	BoneIndices.Add(BoneIndex);
+	LocalA.Add(LocalTransform.GetLocation() + LocalAxis * Length);
+	LocalB.Add(LocalTransform.GetLocation() - LocalAxis * Length);
+}
+
+void FCapsuleLayout::Finalize()
+{
+	NumCapsules = Lengths.Num();
+	Stride = FCapsuleTrace::GetStride(NumCapsules);
+	Radii.SetNumZeroed(Stride);
+
+	static std::atomic<uint32> NextId{ 0 };
+	Id = ++NextId;
+}
+
+void FCapsuleLayout::TransformEndPoints(const TArray<FTransform>& ComponentSpaceTransforms, const FTransform& ComponentToWorld, float* OutPositions) const
+{
+	// capsules of a body are next to each other, only transform each bone once
+	int32 LastBoneIndex = INDEX_NONE;
+	FTransform BoneWorldTransform;
+	for (int32 i = 0; i < NumCapsules; ++i)
+	{
+		if (BoneIndices[i] != LastBoneIndex)
+		{
+			LastBoneIndex = BoneIndices[i];
+			BoneWorldTransform = ComponentSpaceTransforms[LastBoneIndex] * ComponentToWorld;
+		}
+		const FVector A = BoneWorldTransform.TransformPosition(LocalA[i]);
+		const FVector B = BoneWorldTransform.TransformPosition(LocalB[i]);
+
+		OutPositions[i] = A.X;
+		OutPositions[Stride + i] = A.Y;
+		OutPositions[2 * Stride + i] = A.Z;
+		OutPositions[3 * Stride + i] = B.X;
+		OutPositions[4 * Stride + i] = B.Y;
+		OutPositions[5 * Stride + i] = B.Z;
+	}
+}
+
+FBox FCapsuleFrameBracket::GetGroupBounds(int32 Group) const
+{
+	constexpr float Step = FCapsuleLayout::QuantizeStep;
+	const int16* OlderBounds = Older + Layout->GroupBoundsOffset() + 6 * Group;
+	const int16* YoungerBounds = Younger + Layout->GroupBoundsOffset() + 6 * Group;
+	const FBox3f OlderBox(OlderCenter + FVector3f(OlderBounds[0], OlderBounds[1], OlderBounds[2]) * Step, OlderCenter + FVector3f(OlderBounds[3], OlderBounds[4], OlderBounds[5]) * Step);
+	const FBox3f YoungerBox(YoungerCenter + FVector3f(YoungerBounds[0], YoungerBounds[1], YoungerBounds[2]) * Step, YoungerCenter + FVector3f(YoungerBounds[3], YoungerBounds[4], YoungerBounds[5]) * Step);
+	return FBox(OlderBox + YoungerBox);
+}
+
+const float* FCapsuleFrameBracket::GetGroup(int32 Group)
+{
+	constexpr int32 GroupFloats = 6 * FCapsuleTrace::Width;
+	const int32 NumGroups = Layout->NumGroups();
+	if (LerpedGroups.Num() != NumGroups)
+	{
+		LerpedGroups.Init(false, NumGroups);
+		LerpedCapsules.SetNumUninitialized(NumGroups * GroupFloats);
+	}
+
+	float* GroupCapsules = LerpedCapsules.GetData() + Group * GroupFloats;
+	if (!LerpedGroups[Group])
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(SSR_Interpolate);
+		INC_DWORD_STAT(STAT_SSRLerpedGroups);
+		FCapsuleTrace::LerpCapsules(Older, Younger, Layout->Stride, Group * FCapsuleTrace::Width, OlderCenter, YoungerCenter, FCapsuleLayout::QuantizeStep, Alpha, GroupCapsules);
+		LerpedGroups[Group] = true;
+	}
+	return GroupCapsules;
+}
+
+void FCapsuleFrameBracket::SetTime(float Time)
+{
+	const float NewAlpha = Older == Younger ? 0.f : FMath::Clamp((Time - OlderTime) / (YoungerTime - OlderTime), 0.f, 1.f);
+	if (NewAlpha == Alpha) return;
+
+	Alpha = NewAlpha;
+	if (LerpedGroups.Num() > 0)
+	{
+		LerpedGroups.SetRange(0, LerpedGroups.Num(), false);
+	}
+}
+
+void FCapsuleFrameBracket::LerpAll(TArray<float>& OutPositions) const
+{
+	const int32 Stride = Layout->Stride;
+	OutPositions.SetNumUninitialized(6 * Stride);
+	for (int32 Base = 0; Base < Stride; Base += FCapsuleTrace::Width)
+	{
+		float GroupCapsules[6 * FCapsuleTrace::Width];
+		FCapsuleTrace::LerpCapsules(Older, Younger, Stride, Base, OlderCenter, YoungerCenter, FCapsuleLayout::QuantizeStep, Alpha, GroupCapsules);
+		for (int32 Component = 0; Component < 6; ++Component)
+		{
+			FMemory::Memcpy(&OutPositions[Component * Stride + Base], GroupCapsules + Component * FCapsuleTrace::Width, FCapsuleTrace::Width * sizeof(float));
+		}
+	}
+}
+
+int32 FRewindHistory::AddTrack(const FCapsuleLayoutPtr& Layout, int32 Capacity, float MaxRecordTime)
+{
+	check(Layout.IsValid() && Capacity > 0);
+
+	FTrack Track;
+	Track.Layout = Layout;
+	Track.Frames.Init(Capacity);
+	Track.MaxRecordTime = MaxRecordTime;
+	Track.RegionSize = Capacity * Layout->FrameValues();
+
+	const int32 FreeIndex = FreeRegions.IndexOfByPredicate([&Track](const TPair<int32, int32>& Region) { return Region.Value == Track.RegionSize; });
+	if (FreeIndex != INDEX_NONE)
+	{
+		Track.BufferOffset = FreeRegions[FreeIndex].Key;
+		FreeRegions.RemoveAtSwap(FreeIndex);
+		// padding lanes are never written, they have to start out zero
+		FMemory::Memzero(Buffer.GetData() + Track.BufferOffset, Track.RegionSize * sizeof(int16));
+	}
+	else
+	{
+		Track.BufferOffset = Buffer.Num();
+		Buffer.AddZeroed(Track.RegionSize);
+	}
+	return Tracks.Add(MoveTemp(Track));
+}
+
+void FRewindHistory::RemoveTrack(int32 TrackId)
+{
+	if (!IsValidTrack(TrackId)) return;
+	FreeRegions.Emplace(Tracks[TrackId].BufferOffset, Tracks[TrackId].RegionSize);
+	Tracks.RemoveAt(TrackId);
+}
+
+void FRewindHistory::ResetTrack(int32 TrackId)
+{
+	if (!IsValidTrack(TrackId)) return;
+	Tracks[TrackId].Frames.Reset();
+	Tracks[TrackId].bHolding = false;
+	Tracks[TrackId].HistoryBuckets.Reset();
+}
+
+void FRewindHistory::TrimFrames(FTrack& Track, float Time)
+{
+	// keeps the newest frame at or before the start of the window, so a rewind to the start still has a frame either side
+	const float WindowStart = Time - Track.MaxRecordTime;
+	while (Track.Frames.Num() > 1 && Track.Frames[1].Time <= WindowStart)
+	{
+		Track.Frames.RemoveOldest();
+	}
+}
+
+FRewindHistory::FFrame& FRewindHistory::AddSlot(FTrack& Track, float Time)
+{
+	TrimFrames(Track, Time);
+	// reuses the slot of a discarded frame
+	FFrame& Frame = Track.Frames.AddNewest();
+	Frame.Time = Time;
+	return Frame;
+}
+
+float* FRewindHistory::AddFrame(int32 TrackId, float Time)
+{
+	FTrack& Track = Tracks[TrackId];
+	AddSlot(Track, Time);
+	Track.bHolding = false;
+	RecordScratch.SetNumUninitialized(6 * Track.Layout->Stride, EAllowShrinking::No);
+	return RecordScratch.GetData();
+}
+
+void FRewindHistory::HoldFrame(int32 TrackId, float Time)
+{
+	FTrack& Track = Tracks[TrackId];
+	if (Track.Frames.IsEmpty()) return;
+	if (Track.bHolding)
+	{
+		Track.Frames.Newest().Time = Time;
+		TrimFrames(Track, Time);
+		UpdateHistoryBuckets(Track);
+		return;
+	}
+
+	const FFrame Held = Track.Frames.Newest();
+	const int32 HeldSlot = Track.Frames.SlotIndex(Track.Frames.Num() - 1);
+	FFrame& Frame = AddSlot(Track, Time);
+	Frame.Bounds = Held.Bounds;
+	Frame.Center = Held.Center;
+
+	const int32 FrameValues = Track.Layout->FrameValues();
+	const int16* Source = Buffer.GetData() + Track.BufferOffset + HeldSlot * FrameValues;
+	FMemory::Memcpy(GetFrameData(Track, Track.Frames.Num() - 1), Source, FrameValues * sizeof(int16));
+	Track.bHolding = true;
+	UpdateHistoryBuckets(Track);
+}
+
+void FRewindHistory::UpdateHistoryBuckets(FTrack& Track)
+{
+	const FFrame& Newest = Track.Frames.Newest();
+	const int32 Bucket = FMath::FloorToInt(Newest.Time / HistoryBucketTime);
+	if (Track.HistoryBuckets.Num() > 0 && Track.HistoryBuckets.Last().Key == Bucket)
+	{
+		Track.HistoryBuckets.Last().Value += Newest.Bounds;
+	}
+	else
+	{
+		Track.HistoryBuckets.Emplace(Bucket, Newest.Bounds);
+	}
+
+	const int32 OldestBucket = FMath::FloorToInt(Track.Frames.Oldest().Time / HistoryBucketTime);
+	int32 NumDropped = 0;
+	while (NumDropped < Track.HistoryBuckets.Num() - 1 && Track.HistoryBuckets[NumDropped].Key < OldestBucket)
+	{
+		++NumDropped;
+	}
+	Track.HistoryBuckets.RemoveAt(0, NumDropped, EAllowShrinking::No);
+}
+
+FBox3f FRewindHistory::GetHistoryBounds(int32 TrackId) const
+{
+	FBox3f Bounds(ForceInit);
+	for (const TPair<int32, FBox3f>& Bucket : Tracks[TrackId].HistoryBuckets)
+	{
+		Bounds += Bucket.Value;
+	}
+	return Bounds;
+}
+
+static FORCEINLINE int16 QuantizeOffset(float Offset)
+{
+	return static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Offset / FCapsuleLayout::QuantizeStep), -MAX_int16, MAX_int16));
+}
+
+void FRewindHistory::FinishFrame(int32 TrackId)
+{
+	FTrack& Track = Tracks[TrackId];
+	const FCapsuleLayout& Layout = *Track.Layout;
+	const int32 Stride = Layout.Stride;
+	const float* Positions = RecordScratch.GetData();
+
+	// bounds for rejecting traces before anything gets decoded
+	FFrame& Frame = Track.Frames.Newest();
+	TArray<FBox3f, TInlineAllocator<8>> GroupBoxes;
+	Frame.Bounds.Init();
+	for (int32 Group = 0; Group < Layout.NumGroups(); ++Group)
+	{
+		FBox3f GroupBox(ForceInit);
+		float MaxRadius = 0.f;
+		const int32 Base = Group * FCapsuleTrace::Width;
+		const int32 GroupEnd = FMath::Min(Base + FCapsuleTrace::Width, Layout.Num());
+		for (int32 i = Base; i < GroupEnd; ++i)
+		{
+			GroupBox += FVector3f(Positions[i], Positions[Stride + i], Positions[2 * Stride + i]);
+			GroupBox += FVector3f(Positions[3 * Stride + i], Positions[4 * Stride + i], Positions[5 * Stride + i]);
+			MaxRadius = FMath::Max(MaxRadius, Layout.Radii[i]);
+		}
+		GroupBoxes.Add(GroupBox.ExpandBy(MaxRadius));
+		Frame.Bounds += GroupBoxes.Last();
+	}
+	Frame.Center = Frame.Bounds.GetCenter();
+
+	// padding lanes are never written and stay zero
+	int16* Data = GetFrameData(Track, Track.Frames.Num() - 1);
+	for (int32 Component = 0; Component < 6; ++Component)
+	{
+		const float Center = Frame.Center[Component % 3];
+		for (int32 i = 0; i < Layout.Num(); ++i)
+		{
+			Data[Component * Stride + i] = QuantizeOffset(Positions[Component * Stride + i] - Center);
+		}
+	}
+
+	// rounded outwards so the decoded bounds still contain the capsules
+	int16* GroupBounds = Data + Layout.GroupBoundsOffset();
+	for (int32 Group = 0; Group < GroupBoxes.Num(); ++Group)
+	{
+		const FVector3f Min = (GroupBoxes[Group].Min - Frame.Center) / FCapsuleLayout::QuantizeStep;
+		const FVector3f Max = (GroupBoxes[Group].Max - Frame.Center) / FCapsuleLayout::QuantizeStep;
+		int16* GroupOut = GroupBounds + 6 * Group;
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			GroupOut[Axis] = static_cast<int16>(FMath::Max(FMath::FloorToInt(Min[Axis]), -MAX_int16));
+			GroupOut[3 + Axis] = static_cast<int16>(FMath::Min(FMath::CeilToInt(Max[Axis]), MAX_int16));
+		}
+	}
+	UpdateHistoryBuckets(Track);
+}
+
+bool FRewindHistory::FindFrames(int32 TrackId, float Time, FCapsuleFrameBracket& OutBracket) const
+{
+	if (!IsValidTrack(TrackId)) return false;
+	const FTrack& Track = Tracks[TrackId];
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(SSR_Lookup);
+	INC_DWORD_STAT(STAT_SSRFrameLookups);
+	int32 Older, Younger;
+	if (Track.Frames.IsEmpty() || Time < Track.Frames.Newest().Time - Track.MaxRecordTime || !Track.Frames.FindFramesAround(Time, Older, Younger))
+	{
+		// no history, or too far back - too laggy to do SSR
+		return false;
+	}
+
+	const FFrame& OlderFrame = Track.Frames[Older];
+	const FFrame& YoungerFrame = Track.Frames[Younger];
+	OutBracket = FCapsuleFrameBracket();
+	OutBracket.Layout = Track.Layout.Get();
+	OutBracket.Older = GetFrameData(Track, Older);
+	OutBracket.Younger = GetFrameData(Track, Younger);
+	OutBracket.OlderCenter = OlderFrame.Center;
+	OutBracket.YoungerCenter = YoungerFrame.Center;
+	OutBracket.OlderTime = OlderFrame.Time;
+	// past the newest frame the bracket holds it for any later time
+	OutBracket.YoungerTime = Younger == Track.Frames.Num() - 1 && Time >= YoungerFrame.Time ? TNumericLimits<float>::Max() : YoungerFrame.Time;
+	OutBracket.Bounds = FBox(OlderFrame.Bounds + YoungerFrame.Bounds);
+	OutBracket.SetTime(Time);
+	return true;
+}
+
+bool FRewindHistory::SeekFrames(int32 TrackId, float Time, FCapsuleFrameBracket& InOutBracket) const
+{
+	if (InOutBracket.Contains(Time))
+	{
+		InOutBracket.SetTime(Time);
+		return true;
+	}
+	return FindFrames(TrackId, Time, InOutBracket);
+}
+
+SIZE_T FRewindHistory::GetAllocatedSize() const
+{
+	SIZE_T Size = Buffer.GetAllocatedSize() + RecordScratch.GetAllocatedSize() + Tracks.GetAllocatedSize() + FreeRegions.GetAllocatedSize();
+	for (const FTrack& Track : Tracks)
+	{
+		Size += Track.Frames.GetAllocatedSize();
+	}
+	return Size;
+}
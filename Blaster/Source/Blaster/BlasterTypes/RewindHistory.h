@@ -0,0 +1,201 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blaster/BlasterTypes/Hitbox.h"
+#include "Blaster/BlasterTypes/CapsuleTrace.h"
+#include "Blaster/BlasterTypes/FrameHistory.h"
+
+struct FKSphylElem;
+
+// Per-capsule data that doesn't change from frame to frame. Built once per physics asset
+// and shared by every track and frame recorded with it.
+struct FCapsuleLayout
+{
+	// padded with zeros to Stride so the capsule trace can read them 4 at a time
+	TArray<float> Radii;
+	TArray<float> Lengths;
+	TArray<EHitbox> HitboxTypes;
+
+	// bone each capsule is attached to, and the capsule's end points in that bone's space,
+	// so recording a frame is one transform per end point
+	TArray<int32> BoneIndices;
+	TArray<FVector> LocalA;
+	TArray<FVector> LocalB;
+
+	int32 NumCapsules = 0;
+
+	// length of each component array of a frame's end points
+	int32 Stride = 0;
+
+	// Set by Finalize, unique for the life of the process. Tells layouts apart where an address can't, a freed layout's
+	// address can be handed to the next one
+	uint32 Id = 0;
+
+	FORCEINLINE int32 Num() const { return NumCapsules; }
+	FORCEINLINE int32 NumGroups() const { return Stride / FCapsuleTrace::Width; }
+
+	/**
+	* Saved frames are int16 offsets from the centre of the frame's bounds, in steps of QuantizeStep cm:
+	* end points SoA (AX, AY, AZ, BX, BY, BZ), then min/max of each group's bounds.
+	* Offsets reach 32767 * QuantizeStep = 2047 cm from the centre, well past any pose, ragdolls included.
+	* A decoded end point is within QuantizeStep / 2 = 0.03 cm of the recorded one on each axis, and lerping
+	* two decoded frames stays within the same bound. Group bounds are rounded outwards so they still contain their capsules.
+	*/
+	static constexpr float QuantizeStep = 1.f / 16.f;
+
+	FORCEINLINE int32 FrameValues() const { return 6 * Stride + 6 * NumGroups(); }
+	FORCEINLINE int32 GroupBoundsOffset() const { return 6 * Stride; }
+
+	// Adds the capsule of a physics asset Sphyl on bone BoneIndex, at the asset's own scale
+	void AddSphyl(const FKSphylElem& Sphyl, int32 BoneIndex, EHitbox HitboxType);
+
+	// Call once every capsule has been added
+	void Finalize();
+
+	// World space end points of every capsule in a pose, SoA with a stride of Stride. The padding isn't written.
+	void TransformEndPoints(const TArray<FTransform>& ComponentSpaceTransforms, const FTransform& ComponentToWorld, float* OutPositions) const;
+};
+
+typedef TSharedPtr<const FCapsuleLayout, ESPMode::ThreadSafe> FCapsuleLayoutPtr;
+
+// The two saved frames either side of a rewind time. Nothing is interpolated up front,
+// traces only lerp the capsules they can actually reach.
+struct FCapsuleFrameBracket
+{
+	const FCapsuleLayout* Layout = nullptr;
+
+	// frame data laid out as described by FCapsuleLayout::QuantizeStep, and the centre it is relative to
+	const int16* Older = nullptr;
+	const int16* Younger = nullptr;
+	FVector3f OlderCenter = FVector3f::ZeroVector;
+	FVector3f YoungerCenter = FVector3f::ZeroVector;
+	float Alpha = 0.f;
+
+	// times the bracket can be moved between with SetTime, YoungerTime is unbounded past the newest frame
+	float OlderTime = 0.f;
+	float YoungerTime = 0.f;
+
+	// union of both frames' body bounds, the rewound body is somewhere inside it
+	FBox Bounds = FBox(ForceInit);
+
+	FORCEINLINE bool IsValid() const { return Layout != nullptr && Older != nullptr && Younger != nullptr; }
+	FORCEINLINE bool Contains(float Time) const { return IsValid() && Time >= OlderTime && Time <= YoungerTime; }
+
+	// Moves the rewind time between the same two frames. Groups lerped at the old time are lerped again when next reached.
+	void SetTime(float Time);
+
+	// Union of both frames' bounds for one group of capsules
+	FBox GetGroupBounds(int32 Group) const;
+
+	// Lerped capsules of one group, SoA with a stride of FCapsuleTrace::Width.
+	// A group is lerped the first time a trace reaches it and reused by every later trace against this bracket.
+	const float* GetGroup(int32 Group);
+
+	// Lerps every capsule into OutPositions, SoA with a stride of Layout->Stride
+	void LerpAll(TArray<float>& OutPositions) const;
+
+private:
+	TArray<float, TInlineAllocator<6 * FCapsuleTrace::Width * 8>> LerpedCapsules;
+	TBitArray<> LerpedGroups;
+};
+
+/**
+* Capsule histories of every lag compensated character, back to back in one buffer.
+* Each track owns a fixed region of the buffer with one slot per frame of its ring, so recording never allocates.
+* Plain C++ so it can be driven without a world.
+*/
+class FRewindHistory
+{
+public:
+	// Adds a track with room for Capacity frames and returns its id
+	int32 AddTrack(const FCapsuleLayoutPtr& Layout, int32 Capacity, float MaxRecordTime);
+	void RemoveTrack(int32 TrackId);
+	void ResetTrack(int32 TrackId);
+
+	FORCEINLINE bool IsValidTrack(int32 TrackId) const { return Tracks.IsValidIndex(TrackId); }
+	FORCEINLINE const FCapsuleLayout& GetLayout(int32 TrackId) const { return *Tracks[TrackId].Layout; }
+	FORCEINLINE const FCapsuleLayoutPtr& GetLayoutPtr(int32 TrackId) const { return Tracks[TrackId].Layout; }
+	FORCEINLINE int32 NumFrames(int32 TrackId) const { return Tracks[TrackId].Frames.Num(); }
+	FORCEINLINE int32 NumTracks() const { return Tracks.Num(); }
+
+	// Contains every frame the track still holds, and possibly some it has already dropped
+	FBox3f GetHistoryBounds(int32 TrackId) const;
+
+	// Starts a new newest frame at Time, dropping frames older than the track's MaxRecordTime.
+	// Returns world space end points to fill in, SoA with the layout's stride. Call FinishFrame once they are written.
+	float* AddFrame(int32 TrackId, float Time);
+
+	// Computes the bounds of the newest frame and quantises its end points into the track
+	void FinishFrame(int32 TrackId);
+
+	// Records that the pose at Time is still the newest frame's, without storing it again.
+	// The first hold after a new frame copies it into a frame of its own, so rewinds before the hold still interpolate
+	// up to the original frame time. Later holds only move that copy's time forward, trimming the track like AddFrame.
+	void HoldFrame(int32 TrackId, float Time);
+
+	// Finds the frames either side of Time. Returns false if there is no history or Time is more than MaxRecordTime
+	// before the newest frame.
+	bool FindFrames(int32 TrackId, float Time, FCapsuleFrameBracket& OutBracket) const;
+
+	// FindFrames for queries that step through time, like a projectile's flight.
+	// Keeps InOutBracket's frames if Time is still between them and only searches the history when it isn't.
+	bool SeekFrames(int32 TrackId, float Time, FCapsuleFrameBracket& InOutBracket) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	// time, body bounds and quantisation centre of a saved frame, the capsules are in Buffer
+	struct FFrame
+	{
+		float Time = 0.f;
+		FBox3f Bounds = FBox3f(ForceInit);
+		FVector3f Center = FVector3f::ZeroVector;
+	};
+
+	struct FTrack
+	{
+		FCapsuleLayoutPtr Layout;
+		TFrameHistory<FFrame> Frames;
+		float MaxRecordTime = 0.f;
+
+		// the newest frame is a held copy of the one before it
+		bool bHolding = false;
+
+		// Frame bounds merged per HistoryBucketTime of frame time, oldest first. A bucket goes once every frame
+		// in it is dropped, so the union covers the history without touching every frame.
+		TArray<TPair<int32, FBox3f>, TInlineAllocator<12>> HistoryBuckets;
+
+		// first value of the track's region in Buffer
+		int32 BufferOffset = 0;
+		int32 RegionSize = 0;
+	};
+
+	// Drops frames that can't bracket any time in the MaxRecordTime before Time
+	void TrimFrames(FTrack& Track, float Time);
+
+	// Trims the track and starts a new newest frame at Time
+	FFrame& AddSlot(FTrack& Track, float Time);
+
+	// Adds the newest frame's bounds to the track's history buckets and drops buckets older than the oldest frame
+	void UpdateHistoryBuckets(FTrack& Track);
+
+	static constexpr float HistoryBucketTime = 0.25f;
+
+	FORCEINLINE const int16* GetFrameData(const FTrack& Track, int32 Index) const
+	{
+		return Buffer.GetData() + Track.BufferOffset + Track.Frames.SlotIndex(Index) * Track.Layout->FrameValues();
+	}
+	FORCEINLINE int16* GetFrameData(const FTrack& Track, int32 Index)
+	{
+		return Buffer.GetData() + Track.BufferOffset + Track.Frames.SlotIndex(Index) * Track.Layout->FrameValues();
+	}
+
+	TSparseArray<FTrack> Tracks;
+	TArray<int16> Buffer;
+
+	// full precision end points of the frame being recorded
+	TArray<float> RecordScratch;
+
+	// regions of removed tracks, reused by new tracks of the same size
+	TArray<TPair<int32, int32>> FreeRegions;
+};
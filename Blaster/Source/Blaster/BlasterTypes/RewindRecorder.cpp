@@ -0,0 +1,52 @@
+#include "RewindRecorder.h"
+#include "Blaster/Blaster.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Key Frames"), STAT_SSRKeyFrames, STATGROUP_BlasterSSR);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Held Frames"), STAT_SSRHeldFrames, STATGROUP_BlasterSSR);
+
+FRewindRecorder::FRewindRecorder(FRewindHistory& InHistory, FRewindBroadphase& InBroadphase)
+	: History(InHistory)
+	, Broadphase(InBroadphase)
+{
+}
+
+bool FRewindRecorder::RecordFrame(int32 Track, float Time, const TArray<FTransform>& ComponentSpaceTransforms, const FTransform& ComponentToWorld, float Tolerance, bool bForceKeyframe, TArray<float>& KeyPositions)
+{
+	const FCapsuleLayout& Layout = History.GetLayout(Track);
+	Pose.SetNumUninitialized(6 * Layout.Stride, EAllowShrinking::No);
+	Layout.TransformEndPoints(ComponentSpaceTransforms, ComponentToWorld, Pose.GetData());
+
+	const bool bKeyframe = bForceKeyframe || NeedsKeyframe(Track, Layout, Tolerance, KeyPositions);
+	if (bKeyframe)
+	{
+		float* Positions = History.AddFrame(Track, Time);
+		FMemory::Memcpy(Positions, Pose.GetData(), Pose.Num() * sizeof(float));
+		History.FinishFrame(Track);
+		Swap(KeyPositions, Pose);
+		INC_DWORD_STAT(STAT_SSRKeyFrames);
+	}
+	else
+	{
+		History.HoldFrame(Track, Time);
+		INC_DWORD_STAT(STAT_SSRHeldFrames);
+	}
+	Broadphase.Update(Track, History.GetHistoryBounds(Track));
+	return bKeyframe;
+}
+
+bool FRewindRecorder::NeedsKeyframe(int32 Track, const FCapsuleLayout& Layout, float Tolerance, const TArray<float>& KeyPositions) const
+{
+	if (Tolerance <= 0.f || History.NumFrames(Track) == 0 || KeyPositions.Num() != Pose.Num()) return true;
+
+	// any end point moving further than the tolerance from the last stored frame
+	for (int32 Component = 0; Component < 6; ++Component)
+	{
+		const float* PoseComponent = Pose.GetData() + Component * Layout.Stride;
+		const float* KeyComponent = KeyPositions.GetData() + Component * Layout.Stride;
+		for (int32 i = 0; i < Layout.Num(); ++i)
+		{
+			if (FMath::Abs(PoseComponent[i] - KeyComponent[i]) > Tolerance) return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+#include "Blaster/BlasterTypes/RewindBroadphase.h"
+
+/**
+* Records poses into an FRewindHistory and keeps the broadphase up to date: gathers a track's capsule end points
+* from its bone transforms, then stores them as a new frame or holds the newest one if nothing moved further than
+* the tolerance. Plain C++ like FRewindHistory, ULagCompensationSubsystem feeds it the meshes' bone transforms.
+*/
+class FRewindRecorder
+{
+public:
+	FRewindRecorder(FRewindHistory& InHistory, FRewindBroadphase& InBroadphase);
+
+	// Records Track's pose at Time. KeyPositions are the full precision end points of the track's newest stored frame,
+	// kept by the caller per track and updated here. bForceKeyframe stores a new frame whatever moved.
+	// Returns whether a new frame was stored
+	bool RecordFrame(
+		int32 Track,
+		float Time,
+		const TArray<FTransform>& ComponentSpaceTransforms,
+		const FTransform& ComponentToWorld,
+		float Tolerance,
+		bool bForceKeyframe,
+		TArray<float>& KeyPositions
+	);
+
+	// Whether the gathered pose has to be stored as a new frame: any end point moved further than Tolerance
+	// from KeyPositions, or there's nothing to hold
+	bool NeedsKeyframe(int32 Track, const FCapsuleLayout& Layout, float Tolerance, const TArray<float>& KeyPositions) const;
+
+private:
+	FRewindHistory& History;
+	FRewindBroadphase& Broadphase;
+
+	// end points of the track being recorded, swapped with its KeyPositions when stored
+	TArray<float> Pose;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTLS.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Counts the allocations made by one thread between Begin and End, forwarding everything to the allocator it stands in for.
+// Only ever one, never destroyed, so a thread still inside it after End is fine
+class FAllocationCounter final : public FMalloc
+{
+public:
+	static FAllocationCounter& Get()
+	{
+		static FAllocationCounter Counter;
+		return Counter;
+	}
+
+	void Begin()
+	{
+		check(GMalloc != this);
+		Count = 0;
+		ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Inner = GMalloc;
+		GMalloc = this;
+	}
+
+	// Inner stays set, other threads may still be calling through this
+	int32 End()
+	{
+		GMalloc = Inner;
+		return Count;
+	}
+
+	virtual void* Malloc(SIZE_T Size, uint32 Alignment) override { Counted(); return Inner->Malloc(Size, Alignment); }
+	virtual void* TryMalloc(SIZE_T Size, uint32 Alignment) override { Counted(); return Inner->TryMalloc(Size, Alignment); }
+	virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override { Counted(); return Inner->Realloc(Original, Size, Alignment); }
+	virtual void* TryRealloc(void* Original, SIZE_T Size, uint32 Alignment) override { Counted(); return Inner->TryRealloc(Original, Size, Alignment); }
+	virtual void Free(void* Original) override { Inner->Free(Original); }
+	virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override { return Inner->QuantizeSize(Size, Alignment); }
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+	virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+	virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+	virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+private:
+	void Counted()
+	{
+		if (FPlatformTLS::GetCurrentThreadId() == ThreadId)
+		{
+			++Count;
+		}
+	}
+
+	FMalloc* Inner = nullptr;
+	uint32 ThreadId = 0;
+	int32 Count = 0;
+};
+
+#endif // WITH_DEV_AUTOMATION_TESTS
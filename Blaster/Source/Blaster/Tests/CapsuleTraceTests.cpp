@@ -0,0 +1,236 @@
+#include "Misc/AutomationTest.h"
+#include "Blaster/BlasterTypes/CapsuleTrace.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+#include "Blaster/BlasterComponents/LagCompensationComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace CapsuleTraceTests
+{
+	// closer than this to a capsule's surface float and double math can disagree, those cases are skipped
+	static constexpr double BoundaryMargin = 0.01;
+
+	static constexpr int32 NumBenchmarkCapsules = 17;
+	static constexpr int32 NumBenchmarkShots = 20000;
+
+	static FVector RandomPoint(FRandomStream& Stream, double Extent)
+	{
+		return FVector(Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Extent, Extent));
+	}
+
+	// a standing body from the head down, the same pose each time Seed is the same, moved along Y by Offset
+	static void MakeBody(int32 Seed, const FCapsuleLayout& Layout, double Offset, float* OutPositions)
+	{
+		FRandomStream Stream(Seed);
+		const int32 Stride = Layout.Stride;
+		for (int32 i = 0; i < Layout.Num(); ++i)
+		{
+			const FVector A(Stream.FRandRange(-20.f, 20.f), Offset + Stream.FRandRange(-20.f, 20.f), 90.f - i * 180.f / Layout.Num());
+			const FVector B = A + FVector(Stream.FRandRange(-10.f, 10.f), Stream.FRandRange(-10.f, 10.f), -Layout.Lengths[i]);
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				OutPositions[Axis * Stride + i] = A[Axis];
+				OutPositions[(3 + Axis) * Stride + i] = B[Axis];
+			}
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapsuleTraceOverlapTest, "Blaster.SSR.CapsuleTrace.OverlapCapsules", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCapsuleTraceOverlapTest::RunTest(const FString& Parameters)
+{
+	using namespace CapsuleTraceTests;
+
+	FRandomStream Stream(0x5D2A);
+	constexpr int32 NumCases = 200;
+	constexpr int32 MaxCapsules = 19;
+	int32 NumCompared = 0;
+	int32 NumHits = 0;
+
+	for (int32 Case = 0; Case < NumCases; ++Case)
+	{
+		// odd counts too, the vector test must ignore the padding lanes
+		const int32 NumCapsules = Stream.RandRange(1, MaxCapsules);
+		const int32 Stride = FCapsuleTrace::GetStride(NumCapsules);
+		TArray<float> Positions;
+		TArray<float> Radii;
+		Positions.SetNumZeroed(6 * Stride);
+		Radii.SetNumZeroed(Stride);
+
+		// a body sized cluster, some capsules degenerate into spheres
+		TArray<FVector> A, B;
+		for (int32 i = 0; i < NumCapsules; ++i)
+		{
+			A.Add(RandomPoint(Stream, 60.0));
+			B.Add(Stream.FRand() < 0.1f ? A.Last() : A.Last() + RandomPoint(Stream, 30.0));
+			Radii[i] = Stream.FRandRange(3.f, 20.f);
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				Positions[Axis * Stride + i] = A.Last()[Axis];
+				Positions[(3 + Axis) * Stride + i] = B.Last()[Axis];
+			}
+		}
+
+		// short traces that start near or inside the body and long ones from across the map
+		const bool bLong = Case % 2 == 0;
+		const FVector Start = bLong ? RandomPoint(Stream, 5000.0) : RandomPoint(Stream, 100.0);
+		const FVector End = bLong ? RandomPoint(Stream, 80.0) - Start.GetSafeNormal() * Stream.FRandRange(0.f, 200.f) : Start + RandomPoint(Stream, 150.0);
+		const FVector Ray = End - Start;
+		const double Length = Ray.Size();
+		const FVector Dir = Ray / Length;
+
+		FCapsuleIndices Vector, Scalar;
+		FCapsuleTrace::OverlapCapsules(Positions.GetData(), Radii.GetData(), NumCapsules, Stride, Start, End, Vector);
+		FCapsuleTrace::OverlapCapsulesScalar(Positions.GetData(), Radii.GetData(), NumCapsules, Stride, Start, End, Scalar);
+
+		for (int32 i = 0; i < NumCapsules; ++i)
+		{
+			// brute force: the segment touches the capsule if it comes within the radius of the axis
+			FVector OnTrace, OnAxis;
+			FMath::SegmentDistToSegmentSafe(Start, End, A[i], B[i], OnTrace, OnAxis);
+			const double AxisDistance = FVector::Dist(OnTrace, OnAxis);
+			if (FMath::Abs(AxisDistance - Radii[i]) < BoundaryMargin) continue;
+
+			const bool bExpected = AxisDistance <= Radii[i];
+			double Distance;
+			TestTrue(FString::Printf(TEXT("case %d capsule %d, vector"), Case, i), Vector.Contains(i) == bExpected);
+			TestTrue(FString::Printf(TEXT("case %d capsule %d, scalar"), Case, i), Scalar.Contains(i) == bExpected);
+			TestTrue(FString::Printf(TEXT("case %d capsule %d, intersection"), Case, i), FCapsuleTrace::SegmentCapsuleIntersection(Start, Dir, Length, A[i], B[i], Radii[i], Distance) == bExpected);
+			++NumCompared;
+			NumHits += bExpected;
+		}
+		for (int32 Hit : Vector)
+		{
+			TestTrue(FString::Printf(TEXT("case %d hit %d is a real capsule"), Case, Hit), Hit >= 0 && Hit < NumCapsules);
+		}
+	}
+
+	// the random cases have to exercise both outcomes to mean anything
+	TestTrue(TEXT("compared enough capsules"), NumCompared > NumCases * 5);
+	TestTrue(TEXT("some hits"), NumHits > NumCompared / 20);
+	TestTrue(TEXT("some misses"), NumHits < NumCompared - NumCompared / 20);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapsuleTraceIntersectionTest, "Blaster.SSR.CapsuleTrace.SegmentCapsuleIntersection", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCapsuleTraceIntersectionTest::RunTest(const FString& Parameters)
+{
+	const FVector A(0.0, 0.0, -50.0);
+	const FVector B(0.0, 0.0, 50.0);
+	constexpr double Radius = 10.0;
+	double Distance;
+
+	// side of the cylinder body
+	TestTrue(TEXT("body hit"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(-100.0, 0.0, 0.0), FVector(1.0, 0.0, 0.0), 200.0, A, B, Radius, Distance));
+	TestEqual(TEXT("body distance"), Distance, 90.0, 1e-6);
+
+	// straight down onto the top sphere
+	TestTrue(TEXT("cap hit"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(0.0, 0.0, 100.0), FVector(0.0, 0.0, -1.0), 200.0, A, B, Radius, Distance));
+	TestEqual(TEXT("cap distance"), Distance, 40.0, 1e-6);
+
+	TestTrue(TEXT("starting inside"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(0.0, 5.0, 20.0), FVector(1.0, 0.0, 0.0), 10.0, A, B, Radius, Distance));
+	TestEqual(TEXT("inside distance"), Distance, 0.0);
+
+	TestFalse(TEXT("too short"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(-100.0, 0.0, 0.0), FVector(1.0, 0.0, 0.0), 80.0, A, B, Radius, Distance));
+	TestFalse(TEXT("passes beside"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(-100.0, 11.0, 0.0), FVector(1.0, 0.0, 0.0), 200.0, A, B, Radius, Distance));
+	TestFalse(TEXT("passes above"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(-100.0, 0.0, 61.0), FVector(1.0, 0.0, 0.0), 200.0, A, B, Radius, Distance));
+	TestFalse(TEXT("points away"), FCapsuleTrace::SegmentCapsuleIntersection(FVector(-100.0, 0.0, 0.0), FVector(-1.0, 0.0, 0.0), 200.0, A, B, Radius, Distance));
+
+	const FVector Normal = FCapsuleTrace::CapsuleNormal(FVector(-10.0, 0.0, 0.0), A, B);
+	TestTrue(TEXT("body normal"), Normal.Equals(FVector(-1.0, 0.0, 0.0), 1e-6));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapsuleTraceBenchmarkTest, "Blaster.SSR.Benchmark.CapsuleTrace", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCapsuleTraceBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace CapsuleTraceTests;
+
+	FRandomStream Stream(0xC4B5);
+	TSharedRef<FCapsuleLayout, ESPMode::ThreadSafe> Layout = MakeShared<FCapsuleLayout, ESPMode::ThreadSafe>();
+	for (int32 i = 0; i < NumBenchmarkCapsules; ++i)
+	{
+		Layout->Radii.Add(Stream.FRandRange(8.f, 14.f));
+		Layout->Lengths.Add(Stream.FRandRange(10.f, 25.f));
+		Layout->HitboxTypes.Add(i < 2 ? EHitbox::EH_Head : i < 11 ? EHitbox::EH_Body : EHitbox::EH_Legs);
+		Layout->BoneIndices.Add(i);
+		Layout->LocalA.Add(FVector::ZeroVector);
+		Layout->LocalB.Add(FVector::ZeroVector);
+	}
+	Layout->Finalize();
+
+	// one body recorded twice, a step apart, so every rewind lerps
+	FRewindHistory History;
+	const int32 Track = History.AddTrack(Layout, 4, 1.f);
+	for (int32 Frame = 0; Frame < 2; ++Frame)
+	{
+		MakeBody(0xB0D1, *Layout, Frame * 5.0, History.AddFrame(Track, Frame / 60.f));
+		History.FinishFrame(Track);
+	}
+	const float HitTime = 0.5f / 60.f;
+	FCapsuleFrameBracket Bracket;
+	if (!TestTrue(TEXT("body bracketed"), History.FindFrames(Track, HitTime, Bracket))) return false;
+	TArray<float> Positions;
+	Bracket.LerpAll(Positions);
+
+	// shots at the body from every side and up to 3000 cm away, around half of them hit
+	TArray<FVector> TraceStarts, TraceEnds;
+	for (int32 Shot = 0; Shot < NumBenchmarkShots; ++Shot)
+	{
+		const FVector Target(Stream.FRandRange(-45.f, 45.f), Stream.FRandRange(-45.f, 45.f), Stream.FRandRange(-110.f, 110.f));
+		const FVector TraceStart = Target + Stream.VRand() * Stream.FRandRange(200.f, 3000.f);
+		TraceStarts.Add(TraceStart);
+		TraceEnds.Add(TraceStart + (Target - TraceStart) * 1.25);
+	}
+
+	// single threaded, so shots/sec is per core. The kernels alone against the lerped body, then the whole narrowphase of a shot:
+	// bracket, lerping the groups the trace reaches, the kernel and the nearest hit
+	FCapsuleIndices Hits;
+	int32 VectorHits = 0;
+	uint64 StartCycles = FPlatformTime::Cycles64();
+	for (int32 Shot = 0; Shot < NumBenchmarkShots; ++Shot)
+	{
+		Hits.Reset();
+		FCapsuleTrace::OverlapCapsules(Positions.GetData(), Layout->Radii.GetData(), Layout->Num(), Layout->Stride, TraceStarts[Shot], TraceEnds[Shot], Hits);
+		VectorHits += !Hits.IsEmpty();
+	}
+	const double VectorSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) / NumBenchmarkShots;
+
+	int32 ScalarHits = 0;
+	StartCycles = FPlatformTime::Cycles64();
+	for (int32 Shot = 0; Shot < NumBenchmarkShots; ++Shot)
+	{
+		Hits.Reset();
+		FCapsuleTrace::OverlapCapsulesScalar(Positions.GetData(), Layout->Radii.GetData(), Layout->Num(), Layout->Stride, TraceStarts[Shot], TraceEnds[Shot], Hits);
+		ScalarHits += !Hits.IsEmpty();
+	}
+	const double ScalarSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) / NumBenchmarkShots;
+
+	int32 TraceHits = 0;
+	StartCycles = FPlatformTime::Cycles64();
+	for (int32 Shot = 0; Shot < NumBenchmarkShots; ++Shot)
+	{
+		FCapsuleFrameBracket ShotBracket;
+		History.FindFrames(Track, HitTime, ShotBracket);
+		TraceHits += ULagCompensationComponent::TraceAgainstCapsules(ShotBracket, TraceStarts[Shot], TraceEnds[Shot]).HitType != EHitbox::EH_None;
+	}
+	const double TraceSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) / NumBenchmarkShots;
+
+	// the overlap test above checks hits capsule by capsule, here the counts only have to agree up to shots grazing a capsule
+	TestTrue(TEXT("some shots hit"), VectorHits > NumBenchmarkShots / 10);
+	TestTrue(TEXT("some shots miss"), VectorHits < NumBenchmarkShots - NumBenchmarkShots / 10);
+	TestTrue(TEXT("scalar hits match vector"), FMath::Abs(ScalarHits - VectorHits) <= NumBenchmarkShots / 1000);
+	TestTrue(TEXT("trace hits match vector"), FMath::Abs(TraceHits - VectorHits) <= NumBenchmarkShots / 1000);
+
+	AddInfo(FString::Printf(TEXT("%d capsules, %d shots, %d hit%s"), NumBenchmarkCapsules, NumBenchmarkShots, VectorHits,
+		IConsoleManager::Get().FindConsoleVariable(TEXT("Blaster.SSR.ScalarCapsuleTrace"))->GetBool() ? TEXT(", Blaster.SSR.ScalarCapsuleTrace is set") : TEXT("")));
+	AddInfo(FString::Printf(TEXT("vector kernel: %.1f ns/shot, %.0f shots/sec/core"), VectorSeconds * 1e9, 1.0 / VectorSeconds));
+	AddInfo(FString::Printf(TEXT("scalar kernel: %.1f ns/shot, %.0f shots/sec/core"), ScalarSeconds * 1e9, 1.0 / ScalarSeconds));
+	AddInfo(FString::Printf(TEXT("TraceAgainstCapsules: %.1f ns/shot, %.0f shots/sec/core"), TraceSeconds * 1e9, 1.0 / TraceSeconds));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
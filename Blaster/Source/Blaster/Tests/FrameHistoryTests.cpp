@@ -0,0 +1,307 @@
+#include "Misc/AutomationTest.h"
+#include "Containers/List.h"
+#include "Blaster/BlasterTypes/FrameHistory.h"
+#include "Blaster/Tests/AllocationCounter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace FrameHistoryTests
+{
+	struct FTestFrame
+	{
+		float Time = 0.f;
+	};
+
+	static void AddFrame(TFrameHistory<FTestFrame>& History, float Time)
+	{
+		History.AddNewest().Time = Time;
+	}
+
+	static constexpr float TickRate = 120.f;
+	static constexpr float MaxRecordTime = 2.f;
+	static constexpr int32 NumCharacters = 32;
+	static constexpr float Seconds = 10.f;
+	static constexpr int32 NumLookups = 20000;
+
+	// a saved frame about the size of a character's capsule end points
+	struct FBenchmarkFrame
+	{
+		float Time = 0.f;
+		float Positions[6 * 16];
+	};
+
+	// The history the ring buffer replaced: a node per frame with the newest at the head,
+	// the tail dropped while the history spans more than MaxRecordTime
+	typedef TDoubleLinkedList<FBenchmarkFrame> FLinkedHistory;
+
+	static void AddLinkedFrame(FLinkedHistory& History, const FBenchmarkFrame& Frame)
+	{
+		while (History.Num() > 1 && History.GetHead()->GetValue().Time - History.GetTail()->GetValue().Time > MaxRecordTime)
+		{
+			History.RemoveNode(History.GetTail());
+		}
+		History.AddHead(Frame);
+	}
+
+	// walks back from the newest frame like the old GetFrameToCheckCapsule, the times of the frames either side of Time
+	static bool FindLinkedFrames(const FLinkedHistory& History, float Time, float& OutOlder, float& OutYounger)
+	{
+		const FLinkedHistory::TDoubleLinkedListNode* Younger = History.GetHead();
+		if (Younger == nullptr || History.GetTail()->GetValue().Time > Time) return false;
+		const FLinkedHistory::TDoubleLinkedListNode* Older = Younger;
+		while (Older->GetValue().Time > Time)
+		{
+			Younger = Older;
+			Older = Older->GetNextNode();
+		}
+		OutOlder = Older->GetValue().Time;
+		OutYounger = Older->GetValue().Time == Time ? OutOlder : Younger->GetValue().Time;
+		return true;
+	}
+
+	// the ring with FRewindHistory's trimming, the newest frame at or before the start of the window is kept
+	static void AddRingFrame(TFrameHistory<FBenchmarkFrame>& History, const FBenchmarkFrame& Frame)
+	{
+		while (History.Num() > 1 && History[1].Time <= Frame.Time - MaxRecordTime)
+		{
+			History.RemoveOldest();
+		}
+		History.AddNewest() = Frame;
+	}
+
+	static bool FindRingFrames(const TFrameHistory<FBenchmarkFrame>& History, float Time, float& OutOlder, float& OutYounger)
+	{
+		int32 Older, Younger;
+		if (!History.FindFramesAround(Time, Older, Younger)) return false;
+		OutOlder = History[Older].Time;
+		OutYounger = History[Younger].Time;
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameHistoryWraparoundTest, "Blaster.SSR.FrameHistory.Wraparound", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FFrameHistoryWraparoundTest::RunTest(const FString& Parameters)
+{
+	using namespace FrameHistoryTests;
+
+	constexpr int32 Capacity = 5;
+	TFrameHistory<FTestFrame> History;
+	History.Init(Capacity);
+	TestTrue(TEXT("starts empty"), History.IsEmpty());
+	TestEqual(TEXT("capacity"), History.Capacity(), Capacity);
+
+	// fill past capacity a few times over, the ring has to keep the newest Capacity frames in order
+	for (int32 Frame = 0; Frame < 3 * Capacity + 2; ++Frame)
+	{
+		AddFrame(History, Frame);
+
+		const int32 Expected = FMath::Min(Frame + 1, Capacity);
+		TestEqual(FString::Printf(TEXT("num after frame %d"), Frame), History.Num(), Expected);
+		TestEqual(FString::Printf(TEXT("newest after frame %d"), Frame), History.Newest().Time, float(Frame));
+		TestEqual(FString::Printf(TEXT("oldest after frame %d"), Frame), History.Oldest().Time, float(Frame + 1 - Expected));
+
+		TSet<int32> Slots;
+		for (int32 i = 0; i < History.Num(); ++i)
+		{
+			TestEqual(FString::Printf(TEXT("frame %d of %d"), i, Frame), History[i].Time, float(Frame + 1 - Expected + i));
+			const int32 Slot = History.SlotIndex(i);
+			TestTrue(TEXT("slot in range"), Slot >= 0 && Slot < Capacity);
+			Slots.Add(Slot);
+		}
+		TestEqual(TEXT("every frame has its own slot"), Slots.Num(), History.Num());
+	}
+	TestTrue(TEXT("full"), History.IsFull());
+
+	// a frame keeps its slot while newer frames are added around it
+	const int32 NewestSlot = History.SlotIndex(History.Num() - 1);
+	AddFrame(History, 100.f);
+	TestEqual(TEXT("slot is stable"), History.SlotIndex(History.Num() - 2), NewestSlot);
+
+	// dropping from the front and adding again wraps the head past the end of the slots
+	const float SecondOldest = History[1].Time;
+	History.RemoveOldest();
+	History.RemoveOldest();
+	TestEqual(TEXT("num after remove"), History.Num(), Capacity - 2);
+	TestEqual(TEXT("oldest after remove"), History.Oldest().Time, SecondOldest + 1.f);
+	AddFrame(History, 101.f);
+	AddFrame(History, 102.f);
+	AddFrame(History, 103.f);
+	TestEqual(TEXT("num after refill"), History.Num(), Capacity);
+	TestEqual(TEXT("newest after refill"), History.Newest().Time, 103.f);
+	TestEqual(TEXT("oldest after refill"), History.Oldest().Time, SecondOldest + 2.f);
+
+	History.Reset();
+	TestTrue(TEXT("empty after reset"), History.IsEmpty());
+	History.RemoveOldest();
+	TestEqual(TEXT("removing from an empty history is a no-op"), History.Num(), 0);
+	AddFrame(History, 7.f);
+	TestEqual(TEXT("oldest is newest with one frame"), History.Oldest().Time, History.Newest().Time);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameHistoryFindFramesTest, "Blaster.SSR.FrameHistory.FindFramesAround", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FFrameHistoryFindFramesTest::RunTest(const FString& Parameters)
+{
+	using namespace FrameHistoryTests;
+
+	TFrameHistory<FTestFrame> History;
+	History.Init(8);
+
+	int32 Older = INDEX_NONE;
+	int32 Younger = INDEX_NONE;
+	TestFalse(TEXT("empty history"), History.FindFramesAround(1.f, Older, Younger));
+
+	AddFrame(History, 1.f);
+	TestFalse(TEXT("single frame, before it"), History.FindFramesAround(0.5f, Older, Younger));
+	TestTrue(TEXT("single frame, at it"), History.FindFramesAround(1.f, Older, Younger));
+	TestTrue(TEXT("single frame, at it holds the frame"), Older == 0 && Younger == 0);
+	TestTrue(TEXT("single frame, after it"), History.FindFramesAround(5.f, Older, Younger));
+	TestTrue(TEXT("single frame, after it holds the frame"), Older == 0 && Younger == 0);
+
+	// wrap the ring so the search runs over slots that aren't in order
+	for (int32 Frame = 2; Frame <= 12; ++Frame)
+	{
+		AddFrame(History, Frame);
+	}
+	const float OldestTime = History.Oldest().Time;
+	const float NewestTime = History.Newest().Time;
+	TestEqual(TEXT("wrapped oldest"), OldestTime, 5.f);
+
+	TestFalse(TEXT("before oldest"), History.FindFramesAround(OldestTime - 0.01f, Older, Younger));
+	TestTrue(TEXT("at oldest"), History.FindFramesAround(OldestTime, Older, Younger));
+	TestTrue(TEXT("at oldest is exact"), Older == 0 && Younger == 0);
+	TestTrue(TEXT("at newest"), History.FindFramesAround(NewestTime, Older, Younger));
+	TestTrue(TEXT("at newest is exact"), Older == History.Num() - 1 && Younger == History.Num() - 1);
+	TestTrue(TEXT("after newest"), History.FindFramesAround(NewestTime + 10.f, Older, Younger));
+	TestTrue(TEXT("after newest holds the newest"), Older == History.Num() - 1 && Younger == History.Num() - 1);
+
+	// every time in range against a linear walk
+	for (float Time = OldestTime; Time < NewestTime; Time += 0.125f)
+	{
+		int32 ExpectedOlder = 0;
+		while (ExpectedOlder + 1 < History.Num() && History[ExpectedOlder + 1].Time <= Time)
+		{
+			++ExpectedOlder;
+		}
+		const int32 ExpectedYounger = History[ExpectedOlder].Time == Time ? ExpectedOlder : ExpectedOlder + 1;
+
+		TestTrue(FString::Printf(TEXT("found %.3f"), Time), History.FindFramesAround(Time, Older, Younger));
+		TestEqual(FString::Printf(TEXT("older at %.3f"), Time), Older, ExpectedOlder);
+		TestEqual(FString::Printf(TEXT("younger at %.3f"), Time), Younger, ExpectedYounger);
+		TestTrue(FString::Printf(TEXT("bracketed at %.3f"), Time), History[Older].Time <= Time && History[Younger].Time >= Time);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameHistoryBenchmarkTest, "Blaster.SSR.Benchmark.FrameHistory", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FFrameHistoryBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace FrameHistoryTests;
+
+	TArray<TFrameHistory<FBenchmarkFrame>> Rings;
+	TArray<FLinkedHistory> Lists;
+	Rings.SetNum(NumCharacters);
+	Lists.SetNum(NumCharacters);
+	for (TFrameHistory<FBenchmarkFrame>& Ring : Rings)
+	{
+		Ring.Init(FMath::CeilToInt(MaxRecordTime * TickRate) + 2);
+	}
+
+	// every character records a frame a tick, the first MaxRecordTime fills the histories and isn't measured
+	FBenchmarkFrame Frame;
+	FMemory::Memzero(Frame.Positions);
+	const int32 NumFrames = FMath::CeilToInt(Seconds * TickRate);
+	const int32 WarmupFrames = FMath::CeilToInt(MaxRecordTime * TickRate) + 1;
+	uint64 RingRecordCycles = 0, ListRecordCycles = 0;
+	int32 RingAllocations = 0, ListAllocations = 0;
+	for (int32 Tick = 0; Tick < NumFrames; ++Tick)
+	{
+		Frame.Time = Tick / TickRate;
+		const bool bMeasured = Tick >= WarmupFrames;
+
+		FAllocationCounter::Get().Begin();
+		uint64 Start = FPlatformTime::Cycles64();
+		for (int32 Character = 0; Character < NumCharacters; ++Character)
+		{
+			Frame.Positions[0] = Character;
+			AddRingFrame(Rings[Character], Frame);
+		}
+		const uint64 Ring = FPlatformTime::Cycles64() - Start;
+		const int32 RingAllocated = FAllocationCounter::Get().End();
+
+		FAllocationCounter::Get().Begin();
+		Start = FPlatformTime::Cycles64();
+		for (int32 Character = 0; Character < NumCharacters; ++Character)
+		{
+			Frame.Positions[0] = Character;
+			AddLinkedFrame(Lists[Character], Frame);
+		}
+		const uint64 List = FPlatformTime::Cycles64() - Start;
+		const int32 ListAllocated = FAllocationCounter::Get().End();
+
+		if (bMeasured)
+		{
+			RingRecordCycles += Ring;
+			ListRecordCycles += List;
+			RingAllocations += RingAllocated;
+			ListAllocations += ListAllocated;
+		}
+	}
+	const int32 MeasuredFrames = (NumFrames - WarmupFrames) * NumCharacters;
+	TestEqual(TEXT("a full ring records without allocating"), RingAllocations, 0);
+	TestTrue(TEXT("the linked list allocates as it records"), ListAllocations >= MeasuredFrames);
+
+	// rewinds up to MaxRecordTime back, both histories have to bracket every one with the same frames
+	FRandomStream Random(0xF4A3);
+	const float Now = (NumFrames - 1) / TickRate;
+	TArray<TPair<int32, float>> Lookups;
+	for (int32 Lookup = 0; Lookup < NumLookups; ++Lookup)
+	{
+		Lookups.Emplace(Random.RandHelper(NumCharacters), Now - Random.FRandRange(0.f, MaxRecordTime - 1.f / TickRate));
+	}
+
+	float Checksum = 0.f;
+	uint64 Start = FPlatformTime::Cycles64();
+	for (const TPair<int32, float>& Lookup : Lookups)
+	{
+		float Older = 0.f, Younger = 0.f;
+		FindRingFrames(Rings[Lookup.Key], Lookup.Value, Older, Younger);
+		Checksum += Older + Younger;
+	}
+	const uint64 RingLookupCycles = FPlatformTime::Cycles64() - Start;
+
+	Start = FPlatformTime::Cycles64();
+	for (const TPair<int32, float>& Lookup : Lookups)
+	{
+		float Older = 0.f, Younger = 0.f;
+		FindLinkedFrames(Lists[Lookup.Key], Lookup.Value, Older, Younger);
+		Checksum += Older + Younger;
+	}
+	const uint64 ListLookupCycles = FPlatformTime::Cycles64() - Start;
+
+	int32 Mismatches = 0;
+	for (const TPair<int32, float>& Lookup : Lookups)
+	{
+		float RingOlder, RingYounger, ListOlder, ListYounger;
+		const bool bRing = FindRingFrames(Rings[Lookup.Key], Lookup.Value, RingOlder, RingYounger);
+		const bool bList = FindLinkedFrames(Lists[Lookup.Key], Lookup.Value, ListOlder, ListYounger);
+		if (!bRing || !bList || RingOlder != ListOlder || RingYounger != ListYounger)
+		{
+			++Mismatches;
+		}
+	}
+	TestEqual(TEXT("ring and linked list bracket every rewind with the same frames"), Mismatches, 0);
+
+	AddInfo(FString::Printf(TEXT("%d characters at %.0f Hz, %.0f s of history, %d rewinds"), NumCharacters, TickRate, MaxRecordTime, NumLookups));
+	AddInfo(FString::Printf(TEXT("record: ring %.1f ns/frame, %.3f allocations/frame, linked list %.1f ns/frame, %.3f allocations/frame"),
+		FPlatformTime::ToSeconds64(RingRecordCycles) * 1e9 / MeasuredFrames, double(RingAllocations) / MeasuredFrames,
+		FPlatformTime::ToSeconds64(ListRecordCycles) * 1e9 / MeasuredFrames, double(ListAllocations) / MeasuredFrames));
+	AddInfo(FString::Printf(TEXT("lookup: ring %.1f ns, linked list %.1f ns (checksum %.1f)"),
+		FPlatformTime::ToSeconds64(RingLookupCycles) * 1e9 / NumLookups, FPlatformTime::ToSeconds64(ListLookupCycles) * 1e9 / NumLookups, Checksum));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,728 @@
+#include "Misc/AutomationTest.h"
+#include "Algo/AllOf.h"
+#include "Blaster/BlasterTypes/RewindRecorder.h"
+#include "Blaster/BlasterComponents/LagCompensationComponent.h"
+#include "Blaster/BlasterSubsystems/LagCompensationSubsystem.h"
+#include "Blaster/Tests/AllocationCounter.h"
+#include "PhysicsEngine/SphylElem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace RewindBenchmarkTests
+{
+	static constexpr float RecordRate = 60.f;
+	static constexpr float MaxRecordTime = 4.f;
+	static constexpr float RecordTolerance = 0.5f;
+	static constexpr int32 NumCapsules = 17;
+	static constexpr int32 ChestCapsule = 6;
+	static constexpr int32 NumCharacters = 32;
+	static constexpr float Seconds = 10.f;
+	static constexpr float Ping = 0.1f;
+	static constexpr int32 NumShots = 2000;
+	static constexpr int32 NumShotgunShots = 200;
+	static constexpr int32 NumPellets = 10;
+
+	// closer than this to a capsule's surface the vector and scalar capsule tests can disagree, those shots aren't compared
+	static constexpr double BoundaryMargin = 0.01;
+
+	// Roughly the character's physics asset: head, torso and arms, legs from the top down, one bone per capsule
+	static FCapsuleLayoutPtr MakeLayout()
+	{
+		TSharedRef<FCapsuleLayout, ESPMode::ThreadSafe> Layout = MakeShared<FCapsuleLayout, ESPMode::ThreadSafe>();
+		for (int32 i = 0; i < NumCapsules; ++i)
+		{
+			const EHitbox HitboxType = i < 2 ? EHitbox::EH_Head : i < 11 ? EHitbox::EH_Body : EHitbox::EH_Legs;
+			Layout->Radii.Add(HitboxType == EHitbox::EH_Head ? 12.f : HitboxType == EHitbox::EH_Body ? 10.f : 8.f);
+			Layout->Lengths.Add(12.f);
+			Layout->HitboxTypes.Add(HitboxType);
+			Layout->BoneIndices.Add(i);
+			Layout->LocalA.Add(FVector::ZeroVector);
+			Layout->LocalB.Add(FVector(0.0, 0.0, -12.0));
+		}
+		Layout->Finalize();
+		return Layout;
+	}
+
+	// A quarter of the characters stand still, a quarter sway in place by less than the record tolerance
+	// and the rest walk circles, so recording keys some tracks every frame and holds the others
+	static bool IsWalking(int32 Track) { return Track % 4 >= 2; }
+
+	static FTransform GetComponentToWorld(int32 Track, double Time)
+	{
+		const FVector Home((Track % 8) * 600.0, (Track / 8) * 600.0, 0.0);
+		if (!IsWalking(Track))
+		{
+			return FTransform(FRotator(0.0, Track * 37.0, 0.0), Home);
+		}
+		const double Angle = Time * 0.8 + Track * 0.7;
+		return FTransform(FRotator(0.0, FMath::RadiansToDegrees(Angle) + 90.0, 0.0), Home + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * 250.0);
+	}
+
+	static void GetBones(int32 Track, double Time, TArray<FTransform>& OutBones)
+	{
+		const double Amplitude = Track % 4 == 0 ? 0.0 : Track % 4 == 1 ? 0.2 : 8.0;
+		OutBones.SetNum(NumCapsules, EAllowShrinking::No);
+		for (int32 i = 0; i < NumCapsules; ++i)
+		{
+			const double Sway = FMath::Sin(Time * 6.0 + i) * Amplitude;
+			OutBones[i] = FTransform(FRotator(Sway * 0.5, 0.0, 0.0), FVector(Sway, ((i % 3) - 1) * 15.0, 170.0 - i * 9.0));
+		}
+	}
+
+	// where capsule Capsule of Track really was at Time, the way FCapsuleLayout::TransformEndPoints places it
+	static void GetCapsule(const FCapsuleLayout& Layout, int32 Track, double Time, int32 Capsule, FVector& OutA, FVector& OutB)
+	{
+		TArray<FTransform> Bones;
+		GetBones(Track, Time, Bones);
+		const FTransform BoneWorldTransform = Bones[Capsule] * GetComponentToWorld(Track, Time);
+		OutA = BoneWorldTransform.TransformPosition(Layout.LocalA[Capsule]);
+		OutB = BoneWorldTransform.TransformPosition(Layout.LocalB[Capsule]);
+	}
+
+	struct FTraceHit
+	{
+		int32 Track = INDEX_NONE;
+		EHitbox HitType = EHitbox::EH_None;
+		FVector Location = FVector::ZeroVector;
+	};
+
+	static uint32 HashHit(uint32 Checksum, const FTraceHit& Hit)
+	{
+		Checksum = HashCombine(Checksum, HashCombine(GetTypeHash(Hit.Track), GetTypeHash(static_cast<uint8>(Hit.HitType))));
+		if (Hit.Track != INDEX_NONE)
+		{
+			// to the millimetre, well above the quantisation error
+			Checksum = HashCombine(Checksum, GetTypeHash(FIntVector(Hit.Location * 10.0)));
+		}
+		return Checksum;
+	}
+
+	// pellets per track and hitbox type
+	typedef TMap<TPair<int32, EHitbox>, int32> FPelletCounts;
+
+	static uint32 HashCounts(uint32 Checksum, FPelletCounts Counts)
+	{
+		// map order isn't defined, hash in track and hitbox order
+		Counts.KeySort([](const TPair<int32, EHitbox>& A, const TPair<int32, EHitbox>& B) { return A.Key != B.Key ? A.Key < B.Key : A.Value < B.Value; });
+		for (const TPair<TPair<int32, EHitbox>, int32>& Count : Counts)
+		{
+			Checksum = HashCombine(Checksum, HashCombine(HashCombine(GetTypeHash(Count.Key.Key), GetTypeHash(static_cast<uint8>(Count.Key.Value))), GetTypeHash(Count.Value)));
+		}
+		return Checksum;
+	}
+
+	// The segment against every capsule of every track rewound to HitTime: no broadphase, no bounds, every capsule lerped and
+	// intersected one at a time. Within a track the highest hitbox type wins like TraceAgainstCapsules, across tracks the nearest.
+	// bOutNearBoundary if the segment grazes any capsule
+	static FTraceHit TraceEveryCapsule(const FRewindHistory& History, float HitTime, const FVector& TraceStart, const FVector& TraceEnd, bool& bOutNearBoundary)
+	{
+		const FVector TraceDelta = TraceEnd - TraceStart;
+		const FVector Dir = TraceDelta.GetSafeNormal();
+		const double Length = TraceDelta.Size();
+
+		FTraceHit Hit;
+		double HitDistanceSquared = TNumericLimits<double>::Max();
+		TArray<float> Positions;
+		for (int32 Track = 0; Track < NumCharacters; ++Track)
+		{
+			FCapsuleFrameBracket Bracket;
+			if (!History.FindFrames(Track, HitTime, Bracket)) continue;
+			Bracket.LerpAll(Positions);
+
+			const FCapsuleLayout& Layout = *Bracket.Layout;
+			const int32 Stride = Layout.Stride;
+			EHitbox TrackHitType = EHitbox::EH_None;
+			double TrackDistance = TNumericLimits<double>::Max();
+			for (int32 i = 0; i < Layout.Num(); ++i)
+			{
+				const FVector A(Positions[i], Positions[Stride + i], Positions[2 * Stride + i]);
+				const FVector B(Positions[3 * Stride + i], Positions[4 * Stride + i], Positions[5 * Stride + i]);
+				FVector OnTrace, OnAxis;
+				FMath::SegmentDistToSegmentSafe(TraceStart, TraceEnd, A, B, OnTrace, OnAxis);
+				bOutNearBoundary |= FMath::Abs(FVector::Dist(OnTrace, OnAxis) - Layout.Radii[i]) < BoundaryMargin;
+
+				double Distance;
+				if (!FCapsuleTrace::SegmentCapsuleIntersection(TraceStart, Dir, Length, A, B, Layout.Radii[i], Distance)) continue;
+				const EHitbox HitboxType = Layout.HitboxTypes[i];
+				if (HitboxType > TrackHitType || (HitboxType == TrackHitType && Distance < TrackDistance))
+				{
+					TrackHitType = HitboxType;
+					TrackDistance = Distance;
+				}
+			}
+			if (TrackHitType == EHitbox::EH_None) continue;
+
+			const FVector Location = TraceStart + Dir * TrackDistance;
+			const double DistanceSquared = FVector::DistSquared(TraceStart, Location);
+			if (DistanceSquared < HitDistanceSquared)
+			{
+				HitDistanceSquared = DistanceSquared;
+				Hit = FTraceHit{ Track, TrackHitType, Location };
+			}
+		}
+		return Hit;
+	}
+
+	// Rewinds each of Tracks to HitTime and traces the segment against it, the nearest hit wins like ProcessScoreRequests
+	static FTraceHit TraceTracks(const FRewindHistory& History, const FRewindTrackIds& Tracks, float HitTime, const FVector& TraceStart, const FVector& TraceEnd)
+	{
+		FTraceHit Hit;
+		double HitDistanceSquared = TNumericLimits<double>::Max();
+		for (int32 Track : Tracks)
+		{
+			FCapsuleFrameBracket Bracket;
+			if (!History.FindFrames(Track, HitTime, Bracket)) continue;
+
+			const FHitInfo HitInfo = ULagCompensationComponent::TraceAgainstCapsules(Bracket, TraceStart, TraceEnd);
+			if (HitInfo.HitType == EHitbox::EH_None) continue;
+			const double DistanceSquared = FVector::DistSquared(TraceStart, HitInfo.Location);
+			if (DistanceSquared < HitDistanceSquared)
+			{
+				HitDistanceSquared = DistanceSquared;
+				Hit = FTraceHit{ Track, HitInfo.HitType, HitInfo.Location };
+			}
+		}
+		return Hit;
+	}
+
+	// A shot from a couple of thousand cm away at a character's chest as the shooter saw it, a frame of jitter on top of the ping
+	static void MakeShot(FRandomStream& Random, const FCapsuleLayout& Layout, float Now, FVector& OutTraceStart, FVector& OutTarget, float& OutHitTime)
+	{
+		const int32 Track = Random.RandHelper(NumCharacters);
+		OutHitTime = FMath::Max(0.f, Now - Ping - Random.FRandRange(0.f, 1.f / RecordRate));
+		FVector A, B;
+		GetCapsule(Layout, Track, OutHitTime, ChestCapsule, A, B);
+		OutTarget = (A + B) * 0.5 + Random.VRand() * 10.0;
+		const FVector Direction = FVector(Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f), Random.FRandRange(-0.1f, 0.1f)).GetSafeNormal();
+		OutTraceStart = OutTarget + Direction * Random.FRandRange(500.f, 3000.f);
+	}
+
+	// Records every character for Seconds through FRewindRecorder without measuring anything, returns the newest frame's time
+	static float RecordCharacters(const FCapsuleLayoutPtr& Layout, FRewindHistory& History, FRewindBroadphase& Broadphase)
+	{
+		FRewindRecorder Recorder(History, Broadphase);
+		const int32 Capacity = FMath::CeilToInt(MaxRecordTime * RecordRate) + 2;
+		TArray<TArray<float>> KeyPositions;
+		KeyPositions.SetNum(NumCharacters);
+		for (int32 i = 0; i < NumCharacters; ++i)
+		{
+			History.AddTrack(Layout, Capacity, MaxRecordTime);
+		}
+
+		const int32 NumFrames = FMath::CeilToInt(Seconds * RecordRate);
+		TArray<FTransform> Bones;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const float Time = Frame / RecordRate;
+			for (int32 Track = 0; Track < NumCharacters; ++Track)
+			{
+				GetBones(Track, Time, Bones);
+				Recorder.RecordFrame(Track, Time, Bones, GetComponentToWorld(Track, Time), RecordTolerance, false, KeyPositions[Track]);
+			}
+		}
+		return (NumFrames - 1) / RecordRate;
+	}
+
+	struct FBenchmarkResult
+	{
+		uint32 HitscanChecksum = 0;
+		uint32 ShotgunChecksum = 0;
+		int32 KeyFrames = 0;
+		int32 HeldFrames = 0;
+		int32 HitscanHits = 0;
+		int32 PelletHits = 0;
+		int32 Compared = 0;
+		int32 Mismatches = 0;
+		double RecordSeconds = 0.0;
+		double HitscanSeconds = 0.0;
+		double ShotgunSeconds = 0.0;
+		int32 RecordAllocations = 0;
+		int32 HitscanAllocations = 0;
+		int32 ShotgunAllocations = 0;
+	};
+
+	// Records synthetic characters at 60 Hz through FRewindRecorder, the subsystem's record path, then rewinds a seeded corpus of
+	// hitscan shots and shotgun blasts the way ProcessScoreRequests does and checks every one against TraceEveryCapsule
+	static void RunBenchmark(FAutomationTestBase& Test, int32 Seed, FBenchmarkResult& Out)
+	{
+		const FCapsuleLayoutPtr Layout = MakeLayout();
+		FRewindHistory History;
+		FRewindBroadphase Broadphase;
+		FRewindRecorder Recorder(History, Broadphase);
+		const int32 Capacity = FMath::CeilToInt(MaxRecordTime * RecordRate) + 2;
+		TArray<TArray<float>> KeyPositions;
+		KeyPositions.SetNum(NumCharacters);
+		for (int32 i = 0; i < NumCharacters; ++i)
+		{
+			History.AddTrack(Layout, Capacity, MaxRecordTime);
+		}
+
+		// record, bone gather and key or hold decision included. The first second fills the rings and isn't measured
+		const int32 NumFrames = FMath::CeilToInt(Seconds * RecordRate);
+		const int32 WarmupFrames = FMath::CeilToInt(RecordRate);
+		TArray<FTransform> Bones;
+		Bones.Reserve(NumCapsules);
+		uint64 RecordCycles = 0;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const float Time = Frame / RecordRate;
+			const bool bMeasured = Frame >= WarmupFrames;
+			if (bMeasured)
+			{
+				FAllocationCounter::Get().Begin();
+			}
+			const uint64 FrameStart = FPlatformTime::Cycles64();
+			for (int32 Track = 0; Track < NumCharacters; ++Track)
+			{
+				GetBones(Track, Time, Bones);
+				const bool bKeyframe = Recorder.RecordFrame(Track, Time, Bones, GetComponentToWorld(Track, Time), RecordTolerance, false, KeyPositions[Track]);
+				Out.KeyFrames += bKeyframe;
+				Out.HeldFrames += !bKeyframe;
+			}
+			if (bMeasured)
+			{
+				RecordCycles += FPlatformTime::Cycles64() - FrameStart;
+				Out.RecordAllocations += FAllocationCounter::Get().End();
+			}
+		}
+		Out.RecordSeconds = FPlatformTime::ToSeconds64(RecordCycles) / (double(NumFrames - WarmupFrames) * NumCharacters);
+
+		// rewinds stay within twice the record tolerance of the real pose, plus the quantisation
+		FRandomStream Random(Seed);
+		const float Now = (NumFrames - 1) / RecordRate;
+		const double PoseTolerance = 2.0 * RecordTolerance + FCapsuleLayout::QuantizeStep + 0.05;
+		TArray<float> Positions;
+		for (int32 Check = 0; Check < 200; ++Check)
+		{
+			const int32 Track = Random.RandHelper(NumCharacters);
+			const int32 Frame = NumFrames - 1 - Random.RandHelper(FMath::FloorToInt((MaxRecordTime - 0.1f) * RecordRate));
+			FCapsuleFrameBracket Bracket;
+			if (!Test.TestTrue(TEXT("recorded frame found"), History.FindFrames(Track, Frame / RecordRate, Bracket))) continue;
+			Bracket.LerpAll(Positions);
+			for (int32 i = 0; i < NumCapsules; ++i)
+			{
+				FVector A, B;
+				GetCapsule(*Layout, Track, Frame / RecordRate, i, A, B);
+				const FVector RewoundA(Positions[i], Positions[Layout->Stride + i], Positions[2 * Layout->Stride + i]);
+				const FVector RewoundB(Positions[3 * Layout->Stride + i], Positions[4 * Layout->Stride + i], Positions[5 * Layout->Stride + i]);
+				if (FVector::Dist(A, RewoundA) > PoseTolerance || FVector::Dist(B, RewoundB) > PoseTolerance)
+				{
+					Test.AddError(FString::Printf(TEXT("track %d frame %d capsule %d rewound %.3f cm off"), Track, Frame, i, FMath::Max(FVector::Dist(A, RewoundA), FVector::Dist(B, RewoundB))));
+				}
+			}
+		}
+
+		// hitscan, nearest hit per shot like ProcessScoreRequests
+		uint32 ReferenceChecksum = 0;
+		uint64 HitscanCycles = 0;
+		FRewindTrackIds Tracks;
+		for (int32 Shot = 0; Shot < NumShots; ++Shot)
+		{
+			FVector TraceStart, Target;
+			float HitTime;
+			MakeShot(Random, *Layout, Now, TraceStart, Target, HitTime);
+			const FVector TraceEnd = TraceStart + (Target - TraceStart) * 1.25;
+
+			FAllocationCounter::Get().Begin();
+			const uint64 ShotStart = FPlatformTime::Cycles64();
+			Tracks.Reset();
+			Broadphase.QuerySegment(TraceStart, TraceEnd, Tracks);
+			const FTraceHit Hit = TraceTracks(History, Tracks, HitTime, TraceStart, TraceEnd);
+			HitscanCycles += FPlatformTime::Cycles64() - ShotStart;
+			Out.HitscanAllocations += FAllocationCounter::Get().End();
+
+			bool bNearBoundary = false;
+			const FTraceHit Expected = TraceEveryCapsule(History, HitTime, TraceStart, TraceEnd, bNearBoundary);
+			if (bNearBoundary) continue;
+
+			++Out.Compared;
+			if (Hit.Track != Expected.Track || Hit.HitType != Expected.HitType)
+			{
+				++Out.Mismatches;
+				Test.AddError(FString::Printf(TEXT("shot %d hit track %d %s, every capsule says track %d %s"), Shot,
+					Hit.Track, *UEnum::GetValueAsString(Hit.HitType), Expected.Track, *UEnum::GetValueAsString(Expected.HitType)));
+			}
+			Out.HitscanHits += Hit.Track != INDEX_NONE;
+			Out.HitscanChecksum = HashHit(Out.HitscanChecksum, Hit);
+			ReferenceChecksum = HashHit(ReferenceChecksum, Expected);
+		}
+		Test.TestEqual(TEXT("hitscan checksum matches every capsule"), Out.HitscanChecksum, ReferenceChecksum);
+		Out.HitscanSeconds = FPlatformTime::ToSeconds64(HitscanCycles) / NumShots;
+
+		// shotgun, every character any pellet reaches rewound once like ULagCompensationSubsystem::FindRewindVictims
+		ReferenceChecksum = 0;
+		uint64 ShotgunCycles = 0;
+		for (int32 Shot = 0; Shot < NumShotgunShots; ++Shot)
+		{
+			FVector TraceStart, Target;
+			float HitTime;
+			MakeShot(Random, *Layout, Now, TraceStart, Target, HitTime);
+			TArray<FVector, TInlineAllocator<NumPellets>> TraceEnds;
+			for (int32 Pellet = 0; Pellet < NumPellets; ++Pellet)
+			{
+				TraceEnds.Add(TraceStart + (Target + Random.VRand() * Random.FRandRange(0.f, 40.f) - TraceStart) * 1.25);
+			}
+
+			FAllocationCounter::Get().Begin();
+			const uint64 ShotStart = FPlatformTime::Cycles64();
+			FRewindTrackIds ShotTracks;
+			for (const FVector& TraceEnd : TraceEnds)
+			{
+				Tracks.Reset();
+				Broadphase.QuerySegment(TraceStart, TraceEnd, Tracks);
+				for (int32 Track : Tracks)
+				{
+					ShotTracks.AddUnique(Track);
+				}
+			}
+			TArray<FRewindVictim, TInlineAllocator<4>> Victims;
+			TArray<int32, TInlineAllocator<4>> VictimTracks;
+			for (int32 Track : ShotTracks)
+			{
+				FCapsuleFrameBracket Bracket;
+				if (!History.FindFrames(Track, HitTime, Bracket)) continue;
+				Victims.Add(FRewindVictim{ nullptr, MoveTemp(Bracket) });
+				VictimTracks.Add(Track);
+			}
+			FShotgunServerSideRewindResult Result;
+			ULagCompensationComponent::ConfirmShotgunPellets(Victims, TraceStart, TraceEnds, Result);
+			ShotgunCycles += FPlatformTime::Cycles64() - ShotStart;
+			Out.ShotgunAllocations += FAllocationCounter::Get().End();
+
+			// against every pellet traced through every capsule
+			FPelletCounts Counts;
+			for (int32 Victim = 0; Victim < Victims.Num(); ++Victim)
+			{
+				for (EHitbox HitType : { EHitbox::EH_Legs, EHitbox::EH_Body, EHitbox::EH_Head })
+				{
+					if (const int32 Hits = Result.GetHits(Victim, HitType))
+					{
+						Counts.Add(TPair<int32, EHitbox>(VictimTracks[Victim], HitType), Hits);
+					}
+				}
+			}
+			FPelletCounts ExpectedCounts;
+			bool bNearBoundary = false;
+			for (const FVector& TraceEnd : TraceEnds)
+			{
+				const FTraceHit Expected = TraceEveryCapsule(History, HitTime, TraceStart, TraceEnd, bNearBoundary);
+				if (Expected.Track != INDEX_NONE)
+				{
+					++ExpectedCounts.FindOrAdd(TPair<int32, EHitbox>(Expected.Track, Expected.HitType));
+				}
+			}
+			if (bNearBoundary) continue;
+
+			++Out.Compared;
+			const bool bMatches = Counts.Num() == ExpectedCounts.Num() && Algo::AllOf(ExpectedCounts, [&Counts](const FPelletCounts::ElementType& Expected)
+				{
+					const int32* Hits = Counts.Find(Expected.Key);
+					return Hits && *Hits == Expected.Value;
+				});
+			if (!bMatches)
+			{
+				++Out.Mismatches;
+				Test.AddError(FString::Printf(TEXT("shotgun shot %d pellet counts differ from every capsule"), Shot));
+			}
+
+			for (const FPelletCounts::ElementType& Count : Counts)
+			{
+				Out.PelletHits += Count.Value;
+			}
+			Out.ShotgunChecksum = HashCounts(Out.ShotgunChecksum, Counts);
+			ReferenceChecksum = HashCounts(ReferenceChecksum, ExpectedCounts);
+		}
+		Test.TestEqual(TEXT("shotgun checksum matches every capsule"), Out.ShotgunChecksum, ReferenceChecksum);
+		Out.ShotgunSeconds = FPlatformTime::ToSeconds64(ShotgunCycles) / NumShotgunShots;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindBenchmarkTest, "Blaster.SSR.Benchmark.RecordAndRewind", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindBenchmarkTests;
+
+	FBenchmarkResult Result;
+	RunBenchmark(*this, 1, Result);
+
+	// the synthetic characters have to exercise both sides of the record decision and the rewinds have to hit something
+	TestTrue(TEXT("key frames recorded"), Result.KeyFrames > 0);
+	TestTrue(TEXT("held frames recorded"), Result.HeldFrames > 0);
+	TestTrue(TEXT("hitscan shots hit"), Result.HitscanHits > NumShots / 2);
+	TestTrue(TEXT("pellets hit"), Result.PelletHits > 0);
+	TestTrue(TEXT("most shots compared"), Result.Compared > (NumShots + NumShotgunShots) * 9 / 10);
+	TestEqual(TEXT("no shot differs from every capsule"), Result.Mismatches, 0);
+
+	// the same seed has to give the same hits
+	FBenchmarkResult Again;
+	RunBenchmark(*this, 1, Again);
+	TestEqual(TEXT("same seed, same hitscan checksum"), Again.HitscanChecksum, Result.HitscanChecksum);
+	TestEqual(TEXT("same seed, same shotgun checksum"), Again.ShotgunChecksum, Result.ShotgunChecksum);
+	TestEqual(TEXT("same seed, same key frames"), Again.KeyFrames, Result.KeyFrames);
+
+	AddInfo(FString::Printf(TEXT("%d characters, %d key and %d held frames, %d shots and %d shotgun blasts at %.0f ms ping"),
+		NumCharacters, Result.KeyFrames, Result.HeldFrames, NumShots, NumShotgunShots, Ping * 1000.f));
+	AddInfo(FString::Printf(TEXT("record: %.1f ns/frame, %.3f allocations/frame"),
+		Result.RecordSeconds * 1e9, double(Result.RecordAllocations) / ((Seconds - 1.f) * RecordRate * NumCharacters)));
+	AddInfo(FString::Printf(TEXT("hitscan: %.1f ns/shot, %.3f allocations/shot"), Result.HitscanSeconds * 1e9, double(Result.HitscanAllocations) / NumShots));
+	AddInfo(FString::Printf(TEXT("shotgun: %.1f ns/shot, %.3f allocations/shot"), Result.ShotgunSeconds * 1e9, double(Result.ShotgunAllocations) / NumShotgunShots));
+	AddInfo(FString::Printf(TEXT("checksums: hitscan %08x, shotgun %08x"), Result.HitscanChecksum, Result.ShotgunChecksum));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapsuleLayoutBenchmarkTest, "Blaster.SSR.Benchmark.CapsuleLayout", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCapsuleLayoutBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindBenchmarkTests;
+
+	// the physics asset MakeLayout stands in for, one Sphyl per named bone
+	TArray<FKSphylElem> Sphyls;
+	TArray<FName> BoneNames;
+	TMap<FName, EHitbox> HitboxTypes;
+	FCapsuleLayout Layout;
+	for (int32 i = 0; i < NumCapsules; ++i)
+	{
+		const EHitbox HitboxType = i < 2 ? EHitbox::EH_Head : i < 11 ? EHitbox::EH_Body : EHitbox::EH_Legs;
+		FKSphylElem& Sphyl = Sphyls.Emplace_GetRef(HitboxType == EHitbox::EH_Head ? 12.f : HitboxType == EHitbox::EH_Body ? 10.f : 8.f, 12.f);
+		Sphyl.Center = FVector(0.0, 0.0, -6.0);
+		BoneNames.Add(FName(TEXT("bone"), i + 1));
+		HitboxTypes.Add(BoneNames.Last(), HitboxType);
+		Layout.AddSphyl(Sphyl, i, HitboxType);
+	}
+	Layout.Finalize();
+
+	// every character posed every frame both ways: the per tick work before the layout cache, Sphyl transforms,
+	// scaled radii and half lengths and the hitbox lookup, against the cached layout's bone transforms
+	const int32 NumFrames = FMath::CeilToInt(Seconds * RecordRate);
+	const int32 Stride = Layout.Stride;
+	TArray<FTransform> Bones;
+	TArray<float> Cached, Recomputed, Radii;
+	Cached.SetNumZeroed(6 * Stride);
+	Recomputed.SetNumZeroed(6 * Stride);
+	Radii.SetNumZeroed(Stride);
+	TArray<EHitbox> RecomputedTypes;
+	RecomputedTypes.SetNum(NumCapsules);
+	uint64 CachedCycles = 0;
+	uint64 RecomputedCycles = 0;
+	double MaxError = 0.0;
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const float Time = Frame / RecordRate;
+		for (int32 Track = 0; Track < NumCharacters; ++Track)
+		{
+			GetBones(Track, Time, Bones);
+			const FTransform ComponentToWorld = GetComponentToWorld(Track, Time);
+
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			Layout.TransformEndPoints(Bones, ComponentToWorld, Cached.GetData());
+			CachedCycles += FPlatformTime::Cycles64() - StartCycles;
+
+			StartCycles = FPlatformTime::Cycles64();
+			for (int32 i = 0; i < NumCapsules; ++i)
+			{
+				const FTransform WorldTransform = Sphyls[i].GetTransform() * (Bones[i] * ComponentToWorld);
+				const FVector Scale = WorldTransform.GetScale3D();
+				Radii[i] = Sphyls[i].GetScaledRadius(Scale);
+				RecomputedTypes[i] = HitboxTypes.FindChecked(BoneNames[i]);
+				const float Length = Sphyls[i].GetScaledHalfLength(Scale) - Radii[i];
+				const FVector Axis = WorldTransform.GetUnitAxis(EAxis::Z);
+				const FVector A = WorldTransform.GetLocation() + Axis * Length;
+				const FVector B = WorldTransform.GetLocation() - Axis * Length;
+				for (int32 Component = 0; Component < 3; ++Component)
+				{
+					Recomputed[Component * Stride + i] = A[Component];
+					Recomputed[(3 + Component) * Stride + i] = B[Component];
+				}
+			}
+			RecomputedCycles += FPlatformTime::Cycles64() - StartCycles;
+
+			for (int32 i = 0; i < 6 * Stride; ++i)
+			{
+				MaxError = FMath::Max(MaxError, FMath::Abs(double(Cached[i]) - Recomputed[i]));
+			}
+		}
+	}
+
+	TestTrue(TEXT("cached end points match the recomputed ones"), MaxError < 0.01);
+	for (int32 i = 0; i < NumCapsules; ++i)
+	{
+		TestEqual(FString::Printf(TEXT("capsule %d radius"), i), Layout.Radii[i], Radii[i], 1e-4f);
+	}
+	TestTrue(TEXT("cached hitbox types match"), Layout.HitboxTypes == RecomputedTypes);
+
+	const double Players = double(NumFrames) * NumCharacters;
+	const double CachedSeconds = FPlatformTime::ToSeconds64(CachedCycles) / Players;
+	const double RecomputedSeconds = FPlatformTime::ToSeconds64(RecomputedCycles) / Players;
+	AddInfo(FString::Printf(TEXT("%d characters of %d capsules, %d frames"), NumCharacters, NumCapsules, NumFrames));
+	AddInfo(FString::Printf(TEXT("recomputed from Sphyls: %.1f ns/player/frame"), RecomputedSeconds * 1e9));
+	AddInfo(FString::Printf(TEXT("cached layout: %.1f ns/player/frame, %.1f ns saved (%.1fx)"),
+		CachedSeconds * 1e9, (RecomputedSeconds - CachedSeconds) * 1e9, RecomputedSeconds / FMath::Max(CachedSeconds, 1e-12)));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindBroadphaseBenchmarkTest, "Blaster.SSR.Benchmark.Broadphase", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindBroadphaseBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindBenchmarkTests;
+
+	const FCapsuleLayoutPtr Layout = MakeLayout();
+	FRewindHistory History;
+	FRewindBroadphase Broadphase;
+	const float Now = RecordCharacters(Layout, History, Broadphase);
+
+	FRewindTrackIds AllTracks;
+	for (int32 Track = 0; Track < NumCharacters; ++Track)
+	{
+		AllTracks.Add(Track);
+	}
+
+	// every shot rewound twice, through the broadphase and against every character, both have to agree on the hit.
+	// Half the shots are thrown off their target so plenty miss everyone
+	FRandomStream Random(2);
+	FRewindTrackIds Tracks;
+	uint64 BroadphaseCycles = 0;
+	uint64 BruteForceCycles = 0;
+	int32 Candidates = 0;
+	int32 Hits = 0;
+	for (int32 Shot = 0; Shot < NumShots; ++Shot)
+	{
+		FVector TraceStart, Target;
+		float HitTime;
+		MakeShot(Random, *Layout, Now, TraceStart, Target, HitTime);
+		if (Shot % 2 == 1)
+		{
+			Target += Random.VRand() * Random.FRandRange(0.f, 400.f);
+		}
+		const FVector TraceEnd = TraceStart + (Target - TraceStart) * 1.25;
+
+		uint64 StartCycles = FPlatformTime::Cycles64();
+		Tracks.Reset();
+		Broadphase.QuerySegment(TraceStart, TraceEnd, Tracks);
+		const FTraceHit Hit = TraceTracks(History, Tracks, HitTime, TraceStart, TraceEnd);
+		BroadphaseCycles += FPlatformTime::Cycles64() - StartCycles;
+
+		StartCycles = FPlatformTime::Cycles64();
+		const FTraceHit Expected = TraceTracks(History, AllTracks, HitTime, TraceStart, TraceEnd);
+		BruteForceCycles += FPlatformTime::Cycles64() - StartCycles;
+
+		if (Hit.Track != Expected.Track || Hit.HitType != Expected.HitType)
+		{
+			AddError(FString::Printf(TEXT("shot %d hit track %d %s through the broadphase, track %d %s against every character"), Shot,
+				Hit.Track, *UEnum::GetValueAsString(Hit.HitType), Expected.Track, *UEnum::GetValueAsString(Expected.HitType)));
+		}
+		Candidates += Tracks.Num();
+		Hits += Hit.Track != INDEX_NONE;
+	}
+
+	TestTrue(TEXT("some shots hit"), Hits > NumShots / 4);
+	TestTrue(TEXT("some shots miss"), Hits < NumShots - NumShots / 10);
+
+	const double BroadphaseSeconds = FPlatformTime::ToSeconds64(BroadphaseCycles) / NumShots;
+	const double BruteForceSeconds = FPlatformTime::ToSeconds64(BruteForceCycles) / NumShots;
+	AddInfo(FString::Printf(TEXT("%d characters, %d shots, %d hit"), NumCharacters, NumShots, Hits));
+	AddInfo(FString::Printf(TEXT("broadphase: %.1f ns/shot, %.2f characters rewound/shot"), BroadphaseSeconds * 1e9, double(Candidates) / NumShots));
+	AddInfo(FString::Printf(TEXT("every character: %.1f ns/shot, %d characters rewound/shot, %.1fx the broadphase"),
+		BruteForceSeconds * 1e9, NumCharacters, BruteForceSeconds / FMath::Max(BroadphaseSeconds, 1e-12)));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShotgunPelletsBenchmarkTest, "Blaster.SSR.Benchmark.ShotgunPellets", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FShotgunPelletsBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindBenchmarkTests;
+
+	const FCapsuleLayoutPtr Layout = MakeLayout();
+	FRewindHistory History;
+	FRewindBroadphase Broadphase;
+	const float Now = RecordCharacters(Layout, History, Broadphase);
+
+	// every blast confirmed twice over the same victims: ConfirmShotgunPellets with one bracket per victim shared by all pellets,
+	// and each pellet rewinding every victim on its own. The pellet counts have to agree
+	constexpr int32 NumBlasts = 1000;
+	FRandomStream Random(3);
+	FRewindTrackIds Tracks;
+	uint64 SharedCycles = 0;
+	uint64 PerPelletCycles = 0;
+	int32 PelletHits = 0;
+	for (int32 Shot = 0; Shot < NumBlasts; ++Shot)
+	{
+		FVector TraceStart, Target;
+		float HitTime;
+		MakeShot(Random, *Layout, Now, TraceStart, Target, HitTime);
+		TArray<FVector, TInlineAllocator<NumPellets>> TraceEnds;
+		FRewindTrackIds ShotTracks;
+		for (int32 Pellet = 0; Pellet < NumPellets; ++Pellet)
+		{
+			TraceEnds.Add(TraceStart + (Target + Random.VRand() * Random.FRandRange(0.f, 40.f) - TraceStart) * 1.25);
+			Tracks.Reset();
+			Broadphase.QuerySegment(TraceStart, TraceEnds.Last(), Tracks);
+			for (int32 Track : Tracks)
+			{
+				ShotTracks.AddUnique(Track);
+			}
+		}
+
+		uint64 StartCycles = FPlatformTime::Cycles64();
+		TArray<FRewindVictim, TInlineAllocator<4>> Victims;
+		TArray<int32, TInlineAllocator<4>> VictimTracks;
+		for (int32 Track : ShotTracks)
+		{
+			FCapsuleFrameBracket Bracket;
+			if (!History.FindFrames(Track, HitTime, Bracket)) continue;
+			Victims.Add(FRewindVictim{ nullptr, MoveTemp(Bracket) });
+			VictimTracks.Add(Track);
+		}
+		FShotgunServerSideRewindResult Result;
+		ULagCompensationComponent::ConfirmShotgunPellets(Victims, TraceStart, TraceEnds, Result);
+		SharedCycles += FPlatformTime::Cycles64() - StartCycles;
+
+		TArray<FTraceHit, TInlineAllocator<NumPellets>> Hits;
+		StartCycles = FPlatformTime::Cycles64();
+		for (const FVector& TraceEnd : TraceEnds)
+		{
+			Hits.Add(TraceTracks(History, ShotTracks, HitTime, TraceStart, TraceEnd));
+		}
+		PerPelletCycles += FPlatformTime::Cycles64() - StartCycles;
+
+		FPelletCounts Counts;
+		for (int32 Victim = 0; Victim < Victims.Num(); ++Victim)
+		{
+			for (EHitbox HitType : { EHitbox::EH_Legs, EHitbox::EH_Body, EHitbox::EH_Head })
+			{
+				if (const int32 VictimHits = Result.GetHits(Victim, HitType))
+				{
+					Counts.Add(TPair<int32, EHitbox>(VictimTracks[Victim], HitType), VictimHits);
+					PelletHits += VictimHits;
+				}
+			}
+		}
+		FPelletCounts PerPelletCounts;
+		for (const FTraceHit& Hit : Hits)
+		{
+			if (Hit.Track != INDEX_NONE)
+			{
+				++PerPelletCounts.FindOrAdd(TPair<int32, EHitbox>(Hit.Track, Hit.HitType));
+			}
+		}
+		if (HashCounts(0, Counts) != HashCounts(0, PerPelletCounts))
+		{
+			AddError(FString::Printf(TEXT("blast %d pellet counts differ between shared and per pellet rewinds"), Shot));
+		}
+	}
+
+	TestTrue(TEXT("pellets hit"), PelletHits > 0);
+
+	const double Pellets = double(NumBlasts) * NumPellets;
+	const double SharedSeconds = FPlatformTime::ToSeconds64(SharedCycles);
+	const double PerPelletSeconds = FPlatformTime::ToSeconds64(PerPelletCycles);
+	AddInfo(FString::Printf(TEXT("%d blasts of %d pellets, %d pellets hit"), NumBlasts, NumPellets, PelletHits));
+	AddInfo(FString::Printf(TEXT("shared brackets: %.1f ns/pellet, %.0f pellets/sec"), SharedSeconds * 1e9 / Pellets, Pellets / FMath::Max(SharedSeconds, 1e-12)));
+	AddInfo(FString::Printf(TEXT("rewound per pellet: %.1f ns/pellet, %.0f pellets/sec"), PerPelletSeconds * 1e9 / Pellets, Pellets / FMath::Max(PerPelletSeconds, 1e-12)));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,98 @@
+#include "Misc/AutomationTest.h"
+#include "Blaster/BlasterTypes/RewindBroadphase.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace RewindBroadphaseTests
+{
+	static FVector RandomPoint(FRandomStream& Stream, double Extent, double Height)
+	{
+		return FVector(Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Height, Height));
+	}
+
+	// a character's history bounds, now and then one stretched across much of the map like a launched ragdoll
+	static FBox3f RandomBounds(FRandomStream& Stream)
+	{
+		const FVector3f Center = FVector3f(RandomPoint(Stream, 6000.0, 500.0));
+		const bool bOversized = Stream.FRand() < 0.05f;
+		const FVector3f Extent = bOversized
+			? FVector3f(Stream.FRandRange(3000.f, 8000.f), Stream.FRandRange(3000.f, 8000.f), 200.f)
+			: FVector3f(Stream.FRandRange(40.f, 600.f), Stream.FRandRange(40.f, 600.f), Stream.FRandRange(90.f, 200.f));
+		return FBox3f(Center - Extent, Center + Extent);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindBroadphaseQueryTest, "Blaster.SSR.RewindBroadphase.QuerySegment", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindBroadphaseQueryTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindBroadphaseTests;
+
+	FRandomStream Stream(0xB40D);
+	FRewindBroadphase Broadphase;
+	constexpr int32 NumTracks = 48;
+	TArray<FBox3f> Bounds;
+	Bounds.Init(FBox3f(ForceInit), NumTracks);
+
+	int32 NumFound = 0;
+	for (int32 Round = 0; Round < 40; ++Round)
+	{
+		// move, add and remove tracks between queries
+		for (int32 Track = 0; Track < NumTracks; ++Track)
+		{
+			const float Roll = Stream.FRand();
+			if (Roll < 0.1f)
+			{
+				Broadphase.Remove(Track);
+				Bounds[Track] = FBox3f(ForceInit);
+			}
+			else if (Roll < 0.6f || !Bounds[Track].IsValid)
+			{
+				Bounds[Track] = Roll < 0.4f && Bounds[Track].IsValid ? Bounds[Track].ShiftBy(FVector3f(Stream.FRandRange(-300.f, 300.f), Stream.FRandRange(-300.f, 300.f), 0.f)) : RandomBounds(Stream);
+				Broadphase.Update(Track, Bounds[Track]);
+			}
+		}
+
+		for (int32 Query = 0; Query < 50; ++Query)
+		{
+			// hitscan length traces, short shotgun ones and the odd vertical one
+			const FVector Start = RandomPoint(Stream, 7000.0, 600.0);
+			FVector End;
+			switch (Query % 3)
+			{
+			case 0: End = RandomPoint(Stream, 7000.0, 600.0); break;
+			case 1: End = Start + RandomPoint(Stream, 1500.0, 200.0); break;
+			default: End = Start + FVector(Stream.FRandRange(-1.f, 1.f), 0.0, -2000.0); break;
+			}
+
+			FRewindTrackIds Found;
+			Broadphase.QuerySegment(Start, End, Found);
+
+			TSet<int32> FoundSet;
+			for (int32 Track : Found)
+			{
+				FoundSet.Add(Track);
+			}
+			TestEqual(FString::Printf(TEXT("round %d query %d has no duplicates"), Round, Query), FoundSet.Num(), Found.Num());
+			for (int32 Track = 0; Track < NumTracks; ++Track)
+			{
+				const bool bExpected = Bounds[Track].IsValid && FMath::LineBoxIntersection(FBox(Bounds[Track]), Start, End, End - Start);
+				TestTrue(FString::Printf(TEXT("round %d query %d track %d"), Round, Query, Track), FoundSet.Contains(Track) == bExpected);
+				NumFound += bExpected;
+			}
+		}
+	}
+	TestTrue(TEXT("queries found tracks"), NumFound > 0);
+
+	// removing everything leaves nothing to find
+	for (int32 Track = 0; Track < NumTracks; ++Track)
+	{
+		Broadphase.Remove(Track);
+	}
+	FRewindTrackIds Found;
+	Broadphase.QuerySegment(FVector(-10000.0, -10000.0, 0.0), FVector(10000.0, 10000.0, 0.0), Found);
+	TestEqual(TEXT("empty after removing every track"), Found.Num(), 0);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
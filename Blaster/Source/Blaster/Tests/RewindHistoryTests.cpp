@@ -0,0 +1,307 @@
+#include "Misc/AutomationTest.h"
+#include "Blaster/BlasterTypes/RewindHistory.h"
+#include "PhysicsEngine/SphylElem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace RewindHistoryTests
+{
+	static FTransform RandomTransform(FRandomStream& Stream, double Extent)
+	{
+		const FRotator Rotation(Stream.FRandRange(-180.f, 180.f), Stream.FRandRange(-180.f, 180.f), Stream.FRandRange(-180.f, 180.f));
+		const FVector Location(Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Extent, Extent), Stream.FRandRange(-Extent, Extent));
+		return FTransform(Rotation, Location);
+	}
+
+	// a body sized layout of NumCapsules capsules, all on bone 0
+	static FCapsuleLayoutPtr MakeLayout(FRandomStream& Stream, int32 NumCapsules)
+	{
+		TSharedRef<FCapsuleLayout, ESPMode::ThreadSafe> Layout = MakeShared<FCapsuleLayout, ESPMode::ThreadSafe>();
+		for (int32 i = 0; i < NumCapsules; ++i)
+		{
+			Layout->Radii.Add(Stream.FRandRange(3.f, 15.f));
+			Layout->Lengths.Add(Stream.FRandRange(0.f, 20.f));
+			Layout->HitboxTypes.Add(EHitbox::EH_Body);
+			Layout->BoneIndices.Add(0);
+			Layout->LocalA.Add(FVector::ZeroVector);
+			Layout->LocalB.Add(FVector::ZeroVector);
+		}
+		Layout->Finalize();
+		return Layout;
+	}
+
+	// full precision end points of a body around Origin, SoA with the layout's stride and zero padding
+	static void MakePose(FRandomStream& Stream, const FCapsuleLayout& Layout, const FVector& Origin, TArray<float>& OutPositions)
+	{
+		OutPositions.Init(0.f, 6 * Layout.Stride);
+		for (int32 i = 0; i < Layout.Num(); ++i)
+		{
+			for (int32 Component = 0; Component < 6; ++Component)
+			{
+				OutPositions[Component * Layout.Stride + i] = Origin[Component % 3] + Stream.FRandRange(-90.f, 90.f);
+			}
+		}
+	}
+
+	static void RecordPose(FRewindHistory& History, int32 Track, float Time, const TArray<float>& Positions)
+	{
+		float* Frame = History.AddFrame(Track, Time);
+		FMemory::Memcpy(Frame, Positions.GetData(), Positions.Num() * sizeof(float));
+		History.FinishFrame(Track);
+	}
+
+	// largest difference between two poses' end points, ignoring the padding
+	static float MaxError(const FCapsuleLayout& Layout, const TArray<float>& Actual, const TArray<float>& Expected)
+	{
+		float Error = 0.f;
+		for (int32 Component = 0; Component < 6; ++Component)
+		{
+			for (int32 i = 0; i < Layout.Num(); ++i)
+			{
+				const int32 Index = Component * Layout.Stride + i;
+				Error = FMath::Max(Error, FMath::Abs(Actual[Index] - Expected[Index]));
+			}
+		}
+		return Error;
+	}
+
+	// quantisation error bound, plus float rounding of world positions a few thousand cm out
+	static constexpr float QuantizeTolerance = FCapsuleLayout::QuantizeStep / 2.f + 0.002f;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapsuleLayoutTransformTest, "Blaster.SSR.CapsuleLayout.TransformEndPoints", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCapsuleLayoutTransformTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindHistoryTests;
+
+	FRandomStream Stream(0x1A70);
+	constexpr int32 NumBones = 8;
+
+	// one to three capsules per bone, like a physics asset's bodies
+	TArray<FKSphylElem> Sphyls;
+	FCapsuleLayout Layout;
+	for (int32 Bone = 0; Bone < NumBones; ++Bone)
+	{
+		const int32 NumSphyls = Stream.RandRange(1, 3);
+		for (int32 i = 0; i < NumSphyls; ++i)
+		{
+			FKSphylElem& Sphyl = Sphyls.Emplace_GetRef(Stream.FRandRange(3.f, 15.f), Stream.FRandRange(0.f, 40.f));
+			Sphyl.Center = RandomTransform(Stream, 20.0).GetLocation();
+			Sphyl.Rotation = RandomTransform(Stream, 0.0).Rotator();
+			Layout.AddSphyl(Sphyl, Bone, static_cast<EHitbox>(Bone % static_cast<int32>(EHitbox::EH_MAX)));
+		}
+	}
+	Layout.Finalize();
+
+	TestEqual(TEXT("num capsules"), Layout.Num(), Sphyls.Num());
+	TestEqual(TEXT("stride is whole groups"), Layout.Stride % FCapsuleTrace::Width, 0);
+	TestTrue(TEXT("stride fits every capsule"), Layout.Stride >= Layout.Num() && Layout.Stride < Layout.Num() + FCapsuleTrace::Width);
+	TestEqual(TEXT("radii padded to stride"), Layout.Radii.Num(), Layout.Stride);
+	for (int32 i = Layout.Num(); i < Layout.Stride; ++i)
+	{
+		TestEqual(TEXT("padding radius"), Layout.Radii[i], 0.f);
+	}
+
+	TArray<float> Positions;
+	for (int32 Pose = 0; Pose < 10; ++Pose)
+	{
+		TArray<FTransform> ComponentSpaceTransforms;
+		for (int32 Bone = 0; Bone < NumBones; ++Bone)
+		{
+			ComponentSpaceTransforms.Add(RandomTransform(Stream, 100.0));
+		}
+		const FTransform ComponentToWorld = RandomTransform(Stream, 5000.0);
+
+		Positions.SetNumZeroed(6 * Layout.Stride);
+		Layout.TransformEndPoints(ComponentSpaceTransforms, ComponentToWorld, Positions.GetData());
+
+		// the cached end points against transforming every Sphyl into world space each time
+		int32 CapsuleIndex = 0;
+		for (int32 Bone = 0; Bone < NumBones; ++Bone)
+		{
+			const FTransform BoneWorldTransform = ComponentSpaceTransforms[Bone] * ComponentToWorld;
+			for (; CapsuleIndex < Layout.Num() && Layout.BoneIndices[CapsuleIndex] == Bone; ++CapsuleIndex)
+			{
+				const FKSphylElem& Sphyl = Sphyls[CapsuleIndex];
+				const FTransform WorldTransform = Sphyl.GetTransform() * BoneWorldTransform;
+				const float Radius = Sphyl.GetScaledRadius(WorldTransform.GetScale3D());
+				const float Length = Sphyl.GetScaledHalfLength(WorldTransform.GetScale3D()) - Radius;
+				const FVector Axis = WorldTransform.GetUnitAxis(EAxis::Z);
+				const FVector A = WorldTransform.GetLocation() + Axis * Length;
+				const FVector B = WorldTransform.GetLocation() - Axis * Length;
+
+				const int32 Stride = Layout.Stride;
+				const int32 i = CapsuleIndex;
+				const FVector CachedA(Positions[i], Positions[Stride + i], Positions[2 * Stride + i]);
+				const FVector CachedB(Positions[3 * Stride + i], Positions[4 * Stride + i], Positions[5 * Stride + i]);
+				TestEqual(FString::Printf(TEXT("pose %d capsule %d radius"), Pose, i), Layout.Radii[i], Radius, 1e-4f);
+				TestEqual(FString::Printf(TEXT("pose %d capsule %d length"), Pose, i), Layout.Lengths[i], Length, 1e-4f);
+				TestTrue(FString::Printf(TEXT("pose %d capsule %d A"), Pose, i), CachedA.Equals(A, 0.01));
+				TestTrue(FString::Printf(TEXT("pose %d capsule %d B"), Pose, i), CachedB.Equals(B, 0.01));
+			}
+		}
+		TestEqual(TEXT("every capsule checked"), CapsuleIndex, Layout.Num());
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindHistoryQuantizeTest, "Blaster.SSR.RewindHistory.Quantize", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindHistoryQuantizeTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindHistoryTests;
+
+	FRandomStream Stream(0x0B11);
+	FRewindHistory History;
+	const FCapsuleLayoutPtr Layout = MakeLayout(Stream, 17);
+	const int32 Track = History.AddTrack(Layout, 16, 2.f);
+
+	// frames far from the origin, and each saved frame decoded on its own
+	TArray<TArray<float>> Poses;
+	for (int32 Frame = 0; Frame < 12; ++Frame)
+	{
+		const FVector Origin(Stream.FRandRange(-8000.f, 8000.f), Stream.FRandRange(-8000.f, 8000.f), Stream.FRandRange(-500.f, 2000.f));
+		MakePose(Stream, *Layout, Origin, Poses.AddDefaulted_GetRef());
+		RecordPose(History, Track, Frame * 0.1f, Poses.Last());
+	}
+
+	TArray<float> Decoded;
+	for (int32 Frame = 0; Frame < Poses.Num(); ++Frame)
+	{
+		FCapsuleFrameBracket Bracket;
+		TestTrue(FString::Printf(TEXT("frame %d found"), Frame), History.FindFrames(Track, Frame * 0.1f, Bracket));
+		TestTrue(FString::Printf(TEXT("frame %d exact"), Frame), Bracket.Older == Bracket.Younger);
+		Bracket.LerpAll(Decoded);
+		const float Error = MaxError(*Layout, Decoded, Poses[Frame]);
+		TestTrue(FString::Printf(TEXT("frame %d round trip error %.4f within half a step"), Frame, Error), Error <= QuantizeTolerance);
+
+		// the frame's bounds still contain every capsule after rounding
+		for (int32 i = 0; i < Layout->Num(); ++i)
+		{
+			const int32 Stride = Layout->Stride;
+			const FVector A(Poses[Frame][i], Poses[Frame][Stride + i], Poses[Frame][2 * Stride + i]);
+			const FVector B(Poses[Frame][3 * Stride + i], Poses[Frame][4 * Stride + i], Poses[Frame][5 * Stride + i]);
+			const FBox GroupBounds = Bracket.GetGroupBounds(i / FCapsuleTrace::Width);
+			TestTrue(FString::Printf(TEXT("frame %d capsule %d inside its group bounds"), Frame, i), GroupBounds.IsInsideOrOn(A) && GroupBounds.IsInsideOrOn(B));
+			TestTrue(FString::Printf(TEXT("frame %d capsule %d inside the body bounds"), Frame, i), Bracket.Bounds.IsInsideOrOn(A) && Bracket.Bounds.IsInsideOrOn(B));
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindHistoryBracketLerpTest, "Blaster.SSR.RewindHistory.BracketLerp", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindHistoryBracketLerpTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindHistoryTests;
+
+	FRandomStream Stream(0x1E4F);
+	FRewindHistory History;
+	const FCapsuleLayoutPtr Layout = MakeLayout(Stream, 13);
+	const int32 Track = History.AddTrack(Layout, 8, 2.f);
+
+	TArray<float> Older, Younger;
+	const FVector Origin(3000.0, -2500.0, 150.0);
+	MakePose(Stream, *Layout, Origin, Older);
+	MakePose(Stream, *Layout, Origin + FVector(40.0, 10.0, 0.0), Younger);
+	constexpr float OlderTime = 1.f;
+	constexpr float YoungerTime = 1.05f;
+	RecordPose(History, Track, OlderTime, Older);
+	RecordPose(History, Track, YoungerTime, Younger);
+
+	TArray<float> Expected, Lerped;
+	Expected.SetNumZeroed(Older.Num());
+	for (float Alpha = 0.f; Alpha < 1.f; Alpha += 0.125f)
+	{
+		const float Time = FMath::Lerp(OlderTime, YoungerTime, Alpha);
+		FCapsuleFrameBracket Bracket;
+		TestTrue(FString::Printf(TEXT("bracket at %.3f"), Alpha), History.FindFrames(Track, Time, Bracket));
+		for (int32 Index = 0; Index < Older.Num(); ++Index)
+		{
+			Expected[Index] = FMath::Lerp(Older[Index], Younger[Index], Bracket.Alpha);
+		}
+		TestEqual(FString::Printf(TEXT("alpha at %.3f"), Alpha), Bracket.Alpha, Alpha, 1e-3f);
+
+		Bracket.LerpAll(Lerped);
+		const float Error = MaxError(*Layout, Lerped, Expected);
+		TestTrue(FString::Printf(TEXT("LerpAll at %.3f error %.4f within half a step"), Alpha, Error), Error <= QuantizeTolerance);
+
+		// the lazily lerped groups match LerpAll, the second read of a group reuses the first
+		for (int32 Pass = 0; Pass < 2; ++Pass)
+		{
+			for (int32 Group = Layout->NumGroups() - 1; Group >= 0; --Group)
+			{
+				const float* Capsules = Bracket.GetGroup(Group);
+				for (int32 Component = 0; Component < 6; ++Component)
+				{
+					for (int32 Lane = 0; Lane < FCapsuleTrace::Width; ++Lane)
+					{
+						const int32 Index = Component * Layout->Stride + Group * FCapsuleTrace::Width + Lane;
+						TestEqual(TEXT("group matches LerpAll"), Capsules[Component * FCapsuleTrace::Width + Lane], Lerped[Index]);
+					}
+				}
+			}
+		}
+	}
+
+	// moving the time between the same frames lerps the groups again at the new time
+	FCapsuleFrameBracket Bracket;
+	History.FindFrames(Track, FMath::Lerp(OlderTime, YoungerTime, 0.25f), Bracket);
+	Bracket.GetGroup(0);
+	TestTrue(TEXT("contains a later time"), Bracket.Contains(YoungerTime));
+	Bracket.SetTime(YoungerTime);
+	const float* Capsules = Bracket.GetGroup(0);
+	for (int32 Lane = 0; Lane < FMath::Min(FCapsuleTrace::Width, Layout->Num()); ++Lane)
+	{
+		TestEqual(TEXT("group relerped after SetTime"), Capsules[Lane], Younger[Lane], QuantizeTolerance);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FRewindHistoryHoldFrameTest, "Blaster.SSR.RewindHistory.HoldFrame", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FRewindHistoryHoldFrameTest::RunTest(const FString& Parameters)
+{
+	using namespace RewindHistoryTests;
+
+	FRandomStream Stream(0x4017);
+	FRewindHistory History;
+	const FCapsuleLayoutPtr Layout = MakeLayout(Stream, 5);
+	constexpr float MaxRecordTime = 2.f;
+	constexpr float TickRate = 60.f;
+	const int32 Capacity = FMath::CeilToInt(MaxRecordTime * TickRate) + 2;
+	const int32 Track = History.AddTrack(Layout, Capacity, MaxRecordTime);
+
+	TArray<float> Pose;
+	MakePose(Stream, *Layout, FVector(100.0, 200.0, 90.0), Pose);
+	RecordPose(History, Track, 0.f, Pose);
+
+	// a character standing still for a long time only ever holds its one frame
+	float Time = 0.f;
+	for (int32 Tick = 1; Tick <= 600; ++Tick)
+	{
+		Time = Tick / TickRate;
+		History.HoldFrame(Track, Time);
+	}
+	TestTrue(TEXT("held track keeps at most the key frame and its copy"), History.NumFrames(Track) <= 2);
+
+	FCapsuleFrameBracket Bracket;
+	TestTrue(TEXT("rewinds within the window"), History.FindFrames(Track, Time - 0.1f, Bracket));
+	TestTrue(TEXT("rewinds to the window start"), History.FindFrames(Track, Time - MaxRecordTime, Bracket));
+	TestFalse(TEXT("rejects times past the window"), History.FindFrames(Track, Time - MaxRecordTime - 0.1f, Bracket));
+	TestFalse(TEXT("rejects the original frame time"), History.FindFrames(Track, 0.f, Bracket));
+
+	// moving again keeps a frame at or before the window start
+	for (int32 Tick = 1; Tick <= 300; ++Tick)
+	{
+		const float MovedTime = Time + Tick / TickRate;
+		MakePose(Stream, *Layout, FVector(100.0 + Tick, 200.0, 90.0), Pose);
+		RecordPose(History, Track, MovedTime, Pose);
+		TestTrue(FString::Printf(TEXT("window start at tick %d"), Tick), History.FindFrames(Track, MovedTime - MaxRecordTime, Bracket));
+	}
+	TestTrue(TEXT("fits its capacity"), History.NumFrames(Track) < Capacity);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,140 @@
+#include "Misc/AutomationTest.h"
+#include "Blaster/BlasterComponents/LagCompensationComponent.h"
+#include "Blaster/BlasterSubsystems/LagCompensationSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace ShotgunRewindTests
+{
+	// a standing body of NumCapsules capsules stacked along Z around Origin, SoA with the layout's stride
+	static void MakeBody(FRandomStream& Stream, const FCapsuleLayout& Layout, const FVector& Origin, float* OutPositions)
+	{
+		const int32 Stride = Layout.Stride;
+		for (int32 i = 0; i < Layout.Num(); ++i)
+		{
+			const FVector A = Origin + FVector(Stream.FRandRange(-25.f, 25.f), Stream.FRandRange(-25.f, 25.f), -90.f + i * 180.f / Layout.Num());
+			const FVector B = A + FVector(Stream.FRandRange(-10.f, 10.f), Stream.FRandRange(-10.f, 10.f), Layout.Lengths[i]);
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				OutPositions[Axis * Stride + i] = A[Axis];
+				OutPositions[(3 + Axis) * Stride + i] = B[Axis];
+			}
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShotgunRewindPelletsTest, "Blaster.SSR.Shotgun.ConfirmPellets", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FShotgunRewindPelletsTest::RunTest(const FString& Parameters)
+{
+	using namespace ShotgunRewindTests;
+
+	FRandomStream Stream(0x5407);
+	TSharedRef<FCapsuleLayout, ESPMode::ThreadSafe> Layout = MakeShared<FCapsuleLayout, ESPMode::ThreadSafe>();
+	const EHitbox Types[] = { EHitbox::EH_Legs, EHitbox::EH_Legs, EHitbox::EH_Body, EHitbox::EH_Body, EHitbox::EH_Body, EHitbox::EH_Head };
+	for (int32 i = 0; i < UE_ARRAY_COUNT(Types); ++i)
+	{
+		Layout->Radii.Add(Stream.FRandRange(8.f, 16.f));
+		Layout->Lengths.Add(Stream.FRandRange(10.f, 30.f));
+		Layout->HitboxTypes.Add(Types[i]);
+		Layout->BoneIndices.Add(i);
+		Layout->LocalA.Add(FVector::ZeroVector);
+		Layout->LocalB.Add(FVector::ZeroVector);
+	}
+	Layout->Finalize();
+
+	// three victims walking across in front of the shooter, one partly behind another
+	FRewindHistory History;
+	const FVector Origins[] = { FVector(600.0, 0.0, 0.0), FVector(900.0, 40.0, 0.0), FVector(700.0, -250.0, 0.0) };
+	TArray<int32> Tracks;
+	for (const FVector& Origin : Origins)
+	{
+		const int32 Track = History.AddTrack(Layout, 8, 2.f);
+		for (int32 Frame = 0; Frame < 4; ++Frame)
+		{
+			MakeBody(Stream, *Layout, Origin + FVector(0.0, Frame * 8.0, 0.0), History.AddFrame(Track, Frame / 60.f));
+			History.FinishFrame(Track);
+		}
+		Tracks.Add(Track);
+	}
+
+	const FVector TraceStart(0.0, 0.0, 50.0);
+	int32 NumHitPellets = 0;
+	for (int32 Shot = 0; Shot < 20; ++Shot)
+	{
+		const float HitTime = Stream.FRandRange(0.f, 3.f / 60.f);
+
+		// one bracket per victim shared by every pellet of the shot, lerped lazily as pellets reach it
+		TArray<FRewindVictim, TInlineAllocator<4>> Victims;
+		for (int32 Track : Tracks)
+		{
+			FRewindVictim& Victim = Victims.AddDefaulted_GetRef();
+			TestTrue(TEXT("victim bracketed"), History.FindFrames(Track, HitTime, Victim.Bracket));
+		}
+
+		TArray<FVector, TInlineAllocator<16>> TraceEnds;
+		for (int32 Pellet = 0; Pellet < 10; ++Pellet)
+		{
+			const FVector Aim = Origins[Stream.RandRange(0, UE_ARRAY_COUNT(Origins) - 1)] + FVector(0.0, Stream.FRandRange(-60.f, 80.f), Stream.FRandRange(-110.f, 110.f));
+			TraceEnds.Add(TraceStart + (Aim - TraceStart) * 1.25);
+		}
+
+		FShotgunServerSideRewindResult Result;
+		const bool bHit = ULagCompensationComponent::ConfirmShotgunPellets(Victims, TraceStart, TraceEnds, Result);
+		TestEqual(TEXT("a result slot per victim"), Result.Victims.Num(), Victims.Num());
+
+		// every pellet against fresh brackets, nearest victim wins
+		TArray<int32> ExpectedCounts;
+		ExpectedCounts.SetNumZeroed(Victims.Num() * FShotgunServerSideRewindResult::NumHitboxTypes);
+		bool bExpectedHit = false;
+		for (const FVector& TraceEnd : TraceEnds)
+		{
+			int32 HitVictim = INDEX_NONE;
+			EHitbox HitType = EHitbox::EH_None;
+			double HitDistance = TNumericLimits<double>::Max();
+			for (int32 VictimIndex = 0; VictimIndex < Tracks.Num(); ++VictimIndex)
+			{
+				FCapsuleFrameBracket Fresh;
+				History.FindFrames(Tracks[VictimIndex], HitTime, Fresh);
+				const FHitInfo HitInfo = ULagCompensationComponent::TraceAgainstCapsules(Fresh, TraceStart, TraceEnd);
+				if (HitInfo.HitType == EHitbox::EH_None) continue;
+				const double Distance = FVector::DistSquared(TraceStart, HitInfo.Location);
+				if (Distance < HitDistance)
+				{
+					HitDistance = Distance;
+					HitVictim = VictimIndex;
+					HitType = HitInfo.HitType;
+				}
+			}
+			if (HitVictim == INDEX_NONE) continue;
+			++ExpectedCounts[HitVictim * FShotgunServerSideRewindResult::NumHitboxTypes + static_cast<int32>(HitType)];
+			bExpectedHit = true;
+			++NumHitPellets;
+		}
+
+		TestTrue(FString::Printf(TEXT("shot %d hit"), Shot), bHit == bExpectedHit);
+		TestTrue(FString::Printf(TEXT("shot %d hit counts"), Shot), Result.HitCounts == ExpectedCounts);
+
+		// flat damage counts every pellet that hit once, whatever it hit
+		int32 Hits = 0;
+		for (int32 VictimIndex = 0; VictimIndex < Victims.Num(); ++VictimIndex)
+		{
+			TestEqual(TEXT("no pellet counts as a miss"), Result.GetHits(VictimIndex, EHitbox::EH_None), 0);
+			for (EHitbox HitType : { EHitbox::EH_Legs, EHitbox::EH_Body, EHitbox::EH_Head })
+			{
+				Hits += Result.GetHits(VictimIndex, HitType);
+			}
+		}
+		int32 ExpectedHits = 0;
+		for (int32 Count : ExpectedCounts)
+		{
+			ExpectedHits += Count;
+		}
+		TestEqual(FString::Printf(TEXT("shot %d pellets hit"), Shot), Hits, ExpectedHits);
+		TestTrue(FString::Printf(TEXT("shot %d no more hits than pellets"), Shot), Hits <= TraceEnds.Num());
+	}
+	TestTrue(TEXT("pellets hit something"), NumHitPellets > 0);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
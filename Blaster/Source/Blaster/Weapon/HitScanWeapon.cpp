@@ -12,9 +12,9 @@
 #include "WeaponTypes.h"
 #include "Blaster/BlasterComponents/LagCompensationComponent.h"
 
-void AHitScanWeapon::Fire(const FVector& HitTarget)
+void AHitScanWeapon::Fire(const FVector& HitTarget, uint16 InShotSequence)
 {
-	Super::Fire(HitTarget);
+	Super::Fire(HitTarget, InShotSequence);
 
 	APawn* OwnerPawn = Cast<APawn>(GetOwner());
 	if (OwnerPawn == nullptr) return;
@@ -27,7 +27,7 @@ void AHitScanWeapon::Fire(const FVector& HitTarget)
 		FVector Start = SocketTransform.GetLocation();
 
 		FHitResult FireHit;
-		WeaponTraceHit(Start, HitTarget, FireHit);
+		WeaponTraceHit(Start, bUseScatter ? TraceEndWithScatter(Start, HitTarget, InShotSequence) : HitTarget, FireHit);
 
 		ABlasterCharacter* BlasterCharacter = Cast<ABlasterCharacter>(FireHit.GetActor());
 		if (BlasterCharacter && InstigatorController)
@@ -49,10 +49,11 @@ void AHitScanWeapon::Fire(const FVector& HitTarget)
 				BlasterOwnerController = BlasterOwnerController == nullptr ? Cast<ABlasterPlayerController>(InstigatorController) : BlasterOwnerController;
 				if (BlasterOwnerController && BlasterOwnerCharacter && BlasterOwnerCharacter->GetLagCompensation() && BlasterOwnerCharacter->IsLocallyControlled())
 				{
+					// the unscattered target, the server draws the scatter of the shot itself
 					BlasterOwnerCharacter->GetLagCompensation()->ServerScoreRequestCapsule(
-						BlasterCharacter,
 						Start,
 						HitTarget,
+						InShotSequence,
 						BlasterOwnerController->GetServerTime() - BlasterOwnerController->SingleTripTime,
 						this
 					);
@@ -24,6 +24,13 @@ public:
 	FVector_NetQuantize TraceStart;
 	FVector_NetQuantize100 InitialVelocity;
 
+	// server time the owning client fired at
+	float FireTime = 0.f;
+
+	// the shot this projectile is and the weapon that fired it, a score request is only honoured for a shot the server accepted
+	uint16 ShotSequence = 0;
+	TWeakObjectPtr<class AWeapon> FiringWeapon;
+
 	UPROPERTY(EditAnywhere);
 	float InitialSpeed = 15000.f;
 
@@ -6,6 +6,7 @@
 #include "Blaster/Character/BlasterCharacter.h"
 #include "Blaster/PlayerController/BlasterPlayerController.h"
 #include "Blaster/BlasterComponents/LagCompensationComponent.h"
+#include "Blaster/Weapon/Weapon.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 
 AProjectileBullet::AProjectileBullet()
@@ -79,7 +80,9 @@ void AProjectileBullet::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor,
 					HitCharacter, 
 					TraceStart, 
 					InitialVelocity, 
-					OwnerController->GetServerTime() - OwnerController->SingleTripTime
+					ShotSequence,
+					FireTime,
+					FiringWeapon.Get()
 				);
 			}
 		}
@@ -4,10 +4,11 @@
 #include "ProjectileWeapon.h"
 #include "Engine/SkeletalMeshSocket.h"
 #include "Projectile.h"
+#include "Blaster/PlayerController/BlasterPlayerController.h"
 
-void AProjectileWeapon::Fire(const FVector& HitTarget)
+void AProjectileWeapon::Fire(const FVector& HitTarget, uint16 InShotSequence)
 {
-	Super::Fire(HitTarget);
+	Super::Fire(HitTarget, InShotSequence);
 
 	APawn* InstigatorPawn = Cast<APawn>(GetOwner());
 	const USkeletalMeshSocket* MuzzleFlashSocket = GetWeaponMesh()->GetSocketByName(FName("MuzzleFlash"));
@@ -16,7 +17,8 @@ void AProjectileWeapon::Fire(const FVector& HitTarget)
 	{
 		FTransform SocketTransform = MuzzleFlashSocket->GetSocketTransform(GetWeaponMesh());
 		// From muzzle flash socket to hit location from TraceUnderCrosshairs
-		FVector ToTarget = HitTarget - SocketTransform.GetLocation();
+		const FVector Target = bUseScatter ? TraceEndWithScatter(SocketTransform.GetLocation(), HitTarget, InShotSequence) : HitTarget;
+		FVector ToTarget = Target - SocketTransform.GetLocation();
 		FRotator TargetRotation = ToTarget.Rotation();
 
 		FActorSpawnParameters SpawnParams;
@@ -48,6 +50,13 @@ void AProjectileWeapon::Fire(const FVector& HitTarget)
 					SpawnedProjectile->bUseServerSideRewind = true;
 					SpawnedProjectile->TraceStart = SocketTransform.GetLocation();
 					SpawnedProjectile->InitialVelocity = SpawnedProjectile->GetActorForwardVector() * SpawnedProjectile->InitialSpeed;
+					BlasterOwnerController = BlasterOwnerController == nullptr ? Cast<ABlasterPlayerController>(InstigatorPawn->GetController()) : BlasterOwnerController;
+					if (BlasterOwnerController)
+					{
+						SpawnedProjectile->FireTime = BlasterOwnerController->GetServerTime() - BlasterOwnerController->SingleTripTime;
+					}
+					SpawnedProjectile->ShotSequence = InShotSequence;
+					SpawnedProjectile->FiringWeapon = this;
 					SpawnedProjectile->Damage = Damage;
 				}
 				else // client, not locally controlled - spawn non-replicated projectile, no SSR
@@ -68,3 +77,8 @@ void AProjectileWeapon::Fire(const FVector& HitTarget)
 		}
 	}
 }
+
+float AProjectileWeapon::GetServerSideRewindSpeed() const
+{
+	return ServerSideRewindProjectileClass ? ServerSideRewindProjectileClass->GetDefaultObject<AProjectile>()->InitialSpeed : 0.f;
+}
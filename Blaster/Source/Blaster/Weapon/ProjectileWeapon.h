@@ -15,7 +15,10 @@ class BLASTER_API AProjectileWeapon : public AWeapon
 	GENERATED_BODY()
 
 public:
-	virtual void Fire(const FVector& HitTarget) override;
+	virtual void Fire(const FVector& HitTarget, uint16 ShotSequence) override;
+
+	// Launch speed of the projectiles the server rewinds, score requests don't get to choose it
+	float GetServerSideRewindSpeed() const;
 
 private:
 	UPROPERTY(EditAnywhere)
@@ -8,12 +8,11 @@
 #include "Kismet/GameplayStatics.h"
 #include "Particles/ParticleSystemComponent.h"
 #include "Sound/SoundCue.h"
-#include "Kismet/KismetMathLibrary.h"
 #include "Blaster/BlasterComponents/LagCompensationComponent.h"
 
-void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
+void AShotgun::FireShotgun(const FVector_NetQuantize& HitTarget, uint16 InShotSequence)
 {
-	AWeapon::Fire(FVector());
+	AWeapon::Fire(FVector(), InShotSequence);
 
 	APawn* OwnerPawn = Cast<APawn>(GetOwner());
 	if (OwnerPawn == nullptr) return;
@@ -25,13 +24,16 @@ void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
 		const FTransform SocketTransform = MuzzleFlashSocket->GetSocketTransform(GetWeaponMesh());
 		const FVector Start = SocketTransform.GetLocation();
 
+		TArray<FVector_NetQuantize> HitTargets;
+		ShotgunTraceEndWithScatter(Start, HitTarget, InShotSequence, HitTargets);
+
 		// Maps hit character to number of times hit
 		TMap<ABlasterCharacter*, uint32> HitMap;
 
-		for (FVector_NetQuantize HitTarget : HitTargets)
+		for (const FVector_NetQuantize& PelletTarget : HitTargets)
 		{
 			FHitResult FireHit;
-			WeaponTraceHit(Start, HitTarget, FireHit);
+			WeaponTraceHit(Start, PelletTarget, FireHit);
 
 			ABlasterCharacter* BlasterCharacter = Cast<ABlasterCharacter>(FireHit.GetActor());
 			if (BlasterCharacter)
@@ -65,7 +67,6 @@ void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
 				}
 			}
 		}
-		TArray<ABlasterCharacter*> HitCharacters;
 		for (auto HitPair : HitMap)
 		{
 			if (InstigatorController)
@@ -83,7 +84,6 @@ void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
 							UDamageType::StaticClass()
 						);
 					}
-					HitCharacters.Add(HitPair.Key);
 				}
 			}
 		}
@@ -94,9 +94,9 @@ void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
 			if (BlasterOwnerController && BlasterOwnerCharacter && BlasterOwnerCharacter->GetLagCompensation() && BlasterOwnerCharacter->IsLocallyControlled())
 			{
 				BlasterOwnerCharacter->GetLagCompensation()->ShotgunServerScoreRequest(
-					HitCharacters,
 					Start,
-					HitTargets,
+					HitTarget,
+					InShotSequence,
 					BlasterOwnerController->GetServerTime() - BlasterOwnerController->SingleTripTime,
 					this
 				);
@@ -105,23 +105,19 @@ void AShotgun::FireShotgun(const TArray<FVector_NetQuantize>& HitTargets)
 	}
 }
 
-void AShotgun::ShotgunTraceEndWithScatter(const FVector& HitTarget, TArray<FVector_NetQuantize>& HitTargets)
+void AShotgun::ShotgunTraceEndWithScatter(const FVector& TraceStart, const FVector& HitTarget, uint16 InShotSequence, TArray<FVector_NetQuantize>& HitTargets) const
 {
-	const USkeletalMeshSocket* MuzzleFlashSocket = GetWeaponMesh()->GetSocketByName("MuzzleFlash");
-	if (MuzzleFlashSocket == nullptr) return;
-
-	const FTransform SocketTransform = MuzzleFlashSocket->GetSocketTransform(GetWeaponMesh());
-	const FVector TraceStart = SocketTransform.GetLocation();
 	const FVector ToTargetNormalized = (HitTarget - TraceStart).GetSafeNormal();
 	const FVector SphereCenter = TraceStart + ToTargetNormalized * DistanceToSphere;
 
+	FRandomStream Spread(GetScatterSeed(InShotSequence));
+	HitTargets.Reserve(HitTargets.Num() + NumberOfPellets);
 	for (uint32 i = 0; i < NumberOfPellets; ++i)
 	{
-		const FVector RandVec = UKismetMathLibrary::RandomUnitVector() * FMath::FRandRange(0.f, SphereRadius);
+		const FVector RandVec = Spread.VRand() * Spread.FRandRange(0.f, SphereRadius);
 		const FVector EndLoc = SphereCenter + RandVec;
-		FVector ToEndLoc = EndLoc - TraceStart;
-		ToEndLoc = TraceStart + ToEndLoc * TRACE_LENGTH / ToEndLoc.Size();
+		const FVector ToEndLoc = EndLoc - TraceStart;
 
-		HitTargets.Add(TraceEndWithScatter(ToEndLoc));
+		HitTargets.Add(FVector(TraceStart + ToEndLoc * TRACE_LENGTH / ToEndLoc.Size()));
 	}
 }
\ No newline at end of file
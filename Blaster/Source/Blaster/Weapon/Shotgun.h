@@ -15,8 +15,13 @@ class BLASTER_API AShotgun : public AHitScanWeapon
 	GENERATED_BODY()
 	
 public:
-	virtual void FireShotgun(const TArray<FVector_NetQuantize>& HitTargets);
-	void ShotgunTraceEndWithScatter(const FVector& HitTarget, TArray<FVector_NetQuantize>& HitTargets);
+	virtual void FireShotgun(const FVector_NetQuantize& HitTarget, uint16 ShotSequence);
+
+	// Trace ends of every pellet of shot ShotSequence from TraceStart aimed at HitTarget. Seeded like TraceEndWithScatter,
+	// every machine gets the same pellets so a shot only has to send its sequence number instead of the pellets.
+	void ShotgunTraceEndWithScatter(const FVector& TraceStart, const FVector& HitTarget, uint16 ShotSequence, TArray<FVector_NetQuantize>& HitTargets) const;
+
+	virtual int32 GetTracesPerShot() const override { return NumberOfPellets; }
 
 
 
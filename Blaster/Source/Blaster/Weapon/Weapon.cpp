@@ -11,7 +11,6 @@
 #include "Casing.h"
 #include "Engine/SkeletalMeshSocket.h"
 #include "Blaster/PlayerController/BlasterPlayerController.h"
-#include "Kismet/KismetMathLibrary.h"
 
 // Sets default values
 AWeapon::AWeapon()
@@ -35,17 +34,12 @@ AWeapon::AWeapon()
 	PickupWidget->SetupAttachment(RootComponent);
 }
 
-FVector AWeapon::TraceEndWithScatter(const FVector& HitTarget)
+FVector AWeapon::TraceEndWithScatter(const FVector& TraceStart, const FVector& HitTarget, uint16 InShotSequence) const
 {
-	const USkeletalMeshSocket* MuzzleFlashSocket = GetWeaponMesh()->GetSocketByName("MuzzleFlash");
-	if (MuzzleFlashSocket == nullptr) return FVector();
-
-	const FTransform SocketTransform = MuzzleFlashSocket->GetSocketTransform(GetWeaponMesh());
-	const FVector TraceStart = SocketTransform.GetLocation();
-
+	FRandomStream Scatter(GetScatterSeed(InShotSequence));
 	const FVector ToTargetNormalized = (HitTarget - TraceStart).GetSafeNormal();
 	const FVector SphereCenter = TraceStart + ToTargetNormalized * DistanceToSphere;
-	const FVector RandVec = UKismetMathLibrary::RandomUnitVector() * FMath::FRandRange(0.f, SphereRadius);
+	const FVector RandVec = Scatter.VRand() * Scatter.FRandRange(0.f, SphereRadius);
 	const FVector EndLoc = SphereCenter + RandVec;
 	const FVector ToEndLoc = EndLoc - TraceStart;
 
@@ -63,13 +57,60 @@ FVector AWeapon::TraceEndWithScatter(const FVector& HitTarget)
 	*/
 
 	return FVector(TraceStart + ToEndLoc * TRACE_LENGTH / ToEndLoc.Size());
-	
+}
+
+int32 AWeapon::GetScatterSeed(uint16 InShotSequence) const
+{
+	return static_cast<int32>(HashCombine(HashCombine(GetTypeHash(WeaponType), GetTypeHash(ScatterSalt)), GetTypeHash(InShotSequence)));
+}
+
+bool AWeapon::AcceptShotSequence(uint16 InShotSequence)
+{
+	// wraps around, newer means less than half the range ahead
+	const int32 Skip = static_cast<int16>(InShotSequence - LastShotSequence);
+	if (Skip <= 0) return false;
+	if (HasAuthority())
+	{
+		// The shots in between were lost on the way or never fired. Either way they cost what firing them would have:
+		// their fire delay has to have passed and their rounds are spent, this one's is spent when it's played
+		const int32 Skipped = Skip - 1;
+		const float Now = GetWorld() ? GetWorld()->GetTimeSeconds() : 0.f;
+		if (Skipped > MaxShotSequenceSkip || Skip > Ammo) return false;
+		if (Skipped > 0 && LastShotSequence != 0 && Now - LastShotTime + ShotSkipTimeSlack < Skipped * FireDelay) return false;
+		for (int32 i = 0; i < Skipped; ++i)
+		{
+			SpendRound();
+		}
+		LastShotTime = Now;
+
+		// only the shot right after the last one scores, its scatter was never the client's to pick
+		if (Skip == 1)
+		{
+			if (ScorableShots.Num() == MaxScorableShots)
+			{
+				ScorableShots.RemoveAt(0, 1, EAllowShrinking::No);
+			}
+			ScorableShots.Add(InShotSequence);
+		}
+	}
+	LastShotSequence = InShotSequence;
+	return true;
+}
+
+bool AWeapon::ConsumeScorableShot(uint16 InShotSequence)
+{
+	return ScorableShots.Remove(InShotSequence) > 0;
 }
 
 void AWeapon::BeginPlay()
 {
 	Super::BeginPlay();
 
+	if (HasAuthority())
+	{
+		ScatterSalt = FMath::Rand();
+	}
+
 	// want to put this in NewHost() whenever the listen server host changes instead of just having this in BeginPlay()
 	AreaSphere->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
 	AreaSphere->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Overlap);
@@ -95,6 +136,7 @@ void AWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeP
 	DOREPLIFETIME(AWeapon, WeaponState);
 	DOREPLIFETIME_CONDITION(AWeapon, CarriedAmmo, COND_OwnerOnly); // i think this can be deleted and the server controls carried ammo on reload
 	DOREPLIFETIME_CONDITION(AWeapon, bUseServerSideRewind, COND_OwnerOnly);
+	DOREPLIFETIME(AWeapon, ScatterSalt);
 }
 
 void AWeapon::OnSphereOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
@@ -165,6 +207,7 @@ void AWeapon::OnRep_Owner()
 	{
 		BlasterOwnerCharacter = nullptr;
 		BlasterOwnerController = nullptr;
+		ShotSequence = 0;
 	}
 	else
 	{
@@ -291,7 +334,11 @@ void AWeapon::OnDropped()
 	if (HasAuthority())
 	{
 		AreaSphere->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		ScatterSalt = FMath::Rand();
 	}
+	ShotSequence = 0;
+	LastShotSequence = 0;
+	ScorableShots.Reset();
 	WeaponMesh->SetSimulatePhysics(true);
 	WeaponMesh->SetEnableGravity(true);
 	WeaponMesh->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
@@ -318,7 +365,7 @@ void AWeapon::ShowPickupWidget(bool bShowWidget)
 	}
 }
 
-void AWeapon::Fire(const FVector& HitTarget)
+void AWeapon::Fire(const FVector& HitTarget, uint16 InShotSequence)
 {
 	if (FireAnimation)
 	{
@@ -41,7 +41,7 @@ public:
 	virtual void OnRep_Owner() override;
 	void SetHUDAmmo();
 	void ShowPickupWidget(bool bShowWidget);
-	virtual void Fire(const FVector& HitTarget);
+	virtual void Fire(const FVector& HitTarget, uint16 ShotSequence);
 	void Dropped();
 	void SetAmmo(int32 NewAmmo) { Ammo = NewAmmo; }
 	void SetCarriedAmmo(int32 NewAmmo) { CarriedAmmo = NewAmmo; }
@@ -102,7 +102,25 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Weapon Scatter")
 	bool bUseScatter = false;
 
-	FVector TraceEndWithScatter(const FVector& HitTarget);
+	// Scatter of shot ShotSequence of this weapon fired from TraceStart. Every machine draws the same scatter for the same shot,
+	// so shots only send their sequence number.
+	FVector TraceEndWithScatter(const FVector& TraceStart, const FVector& HitTarget, uint16 ShotSequence) const;
+	int32 GetScatterSeed(uint16 ShotSequence) const;
+
+	// Sequence number of the next shot the owning client fires
+	FORCEINLINE uint16 NextShotSequence() { return ++ShotSequence; }
+
+	// Traces the server rewinds for one shot, bounds how many score requests a client can send
+	virtual int32 GetTracesPerShot() const { return 1; }
+
+	// False if ShotSequence isn't newer than the last shot accepted, so a replayed seed can't pick its scatter
+	// and a shot repeated by a later fire event batch is only played once. Server and simulated proxies.
+	// The server charges every skipped shot the ammo and fire delay of a fired one, and only a shot that directly follows
+	// the last one can score, so a client that knows the coming scatters gains nothing by skipping to one it likes
+	bool AcceptShotSequence(uint16 InShotSequence);
+
+	// Server. False unless ShotSequence was accepted and hasn't been scored yet, each shot is scored at most once
+	bool ConsumeScorableShot(uint16 InShotSequence);
 
 	UFUNCTION(Client, Reliable)
 	void ClientUpdateAmmoOnPickup(int32 ServerAmmo);
@@ -198,6 +216,27 @@ private:
 	// Incremented in SpendRound, decremented in ClientUpdateAmmo
 	int32 Sequence = 0;
 
+	// last shot fired by the owning client, and last shot accepted by the server or played by a simulated proxy.
+	// Both restart with each owner
+	uint16 ShotSequence = 0;
+	uint16 LastShotSequence = 0;
+
+	// Server. When the last shot was accepted, and the newest accepted shots that can still be scored
+	float LastShotTime = 0.f;
+	static constexpr int32 MaxScorableShots = 16;
+	TArray<uint16, TInlineAllocator<MaxScorableShots>> ScorableShots;
+
+	// Shots a sequence may skip, covers fire event batches lost in a row
+	static constexpr int32 MaxShotSequenceSkip = 8;
+
+	// Seconds skipped shots may come in ahead of their fire delay, covers batches bunched up by the network
+	static constexpr float ShotSkipTimeSlack = 0.1f;
+
+	// Rolled by the server and mixed into every scatter seed, so the seed of a shot is never the client's to choose.
+	// Rerolled with each owner
+	UPROPERTY(Replicated)
+	int32 ScatterSalt = 0;
+
 	// Carried ammo for this weapon
 	UPROPERTY(ReplicatedUsing = OnRep_CarriedAmmo, EditAnywhere)
 	int32 CarriedAmmo = 0;